@@ -0,0 +1,193 @@
+#pragma once
+// Admission control for the query server. Each request is costed from a
+// running average of how long its intent took before, queued (bounded),
+// and scheduled cheap-first: requests under kExpensiveMs run in arrival
+// order, expensive ones only while a token bucket of expensive time allows
+// (a configured share of wall time). A request is shed when the queue is
+// full or when it can no longer start in time to finish by its deadline
+// (requests costlier than half the deadline keep half of it for queueing);
+// the server then sends a degraded answer instead of letting the queue grow.
+// A client that stops reading its answers for stall_ms is disconnected and
+// its unanswered requests are counted as shed too.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct AdmissionOptions {
+    size_t queue_capacity = 64;
+    double deadline_ms = 1000;       // from arrival to a complete answer
+    double expensive_share = 0.5;    // of wall time spent on expensive requests
+    double stall_ms = 5000;          // output pending with no progress before a client is dropped
+};
+
+class AdmissionControl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        uint64_t id = 0;                 // caller's handle (connection and sequence)
+        std::string query;
+        std::string intent;
+        Clock::time_point arrival;
+        Clock::time_point deadline;
+        double cost_ms = 0;
+    };
+
+    enum class Shed { QUEUE_FULL, DEADLINE, STALLED };
+
+    static constexpr double kExpensiveMs = 20;
+
+    explicit AdmissionControl(AdmissionOptions options = AdmissionOptions()) : options_(options), refilled_(Clock::now()) {
+        tokens_ms_ = burstMs();
+    }
+
+    // Running average, seeded for intents that scan the whole history
+    // (rankings over every day, day lists, statistics, trends, charts).
+    double estimate(const std::string& intent) const {
+        auto it = cost_ms_.find(intent);
+        if (it != cost_ms_.end()) return it->second;
+        static const char* heavy[] = { "rank_all", "worst_days", "best_days", "stats", "history", "trend",
+            "compare", "chart", "forecast", "month" };
+        for (const char* h : heavy) if (intent == h) return 2 * kExpensiveMs;
+        return 1;
+    }
+
+    bool expensive(const Request& r) const { return r.cost_ms >= kExpensiveMs; }
+
+    // False when the queue is full; the request is counted as shed.
+    bool offer(Request request, Clock::time_point now) {
+        if (queue_.size() >= options_.queue_capacity) {
+            shed_[Shed::QUEUE_FULL]++;
+            return false;
+        }
+        request.arrival = now;
+        request.deadline = now + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(options_.deadline_ms));
+        request.cost_ms = estimate(request.intent);
+        queue_.push_back(std::move(request));
+        admitted_++;
+        return true;
+    }
+
+    // The next request to run, if any may run now. Requests that can no
+    // longer finish in time are moved to `expired` (and counted as shed).
+    bool next(Clock::time_point now, Request& out, std::vector<Request>& expired) {
+        refill(now);
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            if (now > latestStart(*it)) {
+                expired.push_back(std::move(*it));
+                it = queue_.erase(it);
+                shed_[Shed::DEADLINE]++;
+            }
+            else ++it;
+        }
+
+        auto pick = queue_.end();
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+            if (!expensive(*it)) { pick = it; break; }
+            if (pick == queue_.end() && tokens_ms_ > 0) pick = it;
+        }
+        if (pick == queue_.end()) return false;
+        out = std::move(*pick);
+        queue_.erase(pick);
+        return true;
+    }
+
+    // When a waiting request could next run (tokens back, or a deadline to
+    // enforce); the server's poll timeout.
+    Clock::duration wait(Clock::time_point now) const {
+        if (queue_.empty()) return Clock::duration::max();
+        for (const auto& r : queue_) if (!expensive(r) || tokens_ms_ > 0) return Clock::duration::zero();
+        double refill_ms = tokens_ms_ > 0 ? 0 : (1 - tokens_ms_) / options_.expensive_share;
+        Clock::duration wait = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(refill_ms));
+        for (const auto& r : queue_) wait = std::min(wait, std::max(Clock::duration::zero(), latestStart(r) - now));
+        return wait;
+    }
+
+    // Feed back the measured cost; expensive work is charged to the bucket.
+    void completed(const Request& request, double ms) {
+        auto it = cost_ms_.find(request.intent);
+        if (it == cost_ms_.end()) cost_ms_[request.intent] = ms;
+        else it->second += 0.2 * (ms - it->second);
+        if (expensive(request)) tokens_ms_ -= ms;
+        served_++;
+    }
+
+    // Remove queued requests (of a dropped client); returns how many.
+    template <typename Match>
+    size_t cancel(Match match) {
+        size_t before = queue_.size();
+        queue_.erase(std::remove_if(queue_.begin(), queue_.end(), match), queue_.end());
+        return before - queue_.size();
+    }
+
+    // A client dropped for not reading, with its unanswered requests.
+    void stalled(size_t requests) {
+        stalled_connections_++;
+        shed_[Shed::STALLED] += requests;
+    }
+
+    Clock::duration stallTimeout() const {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(options_.stall_ms));
+    }
+
+    void degraded(bool stale) { (stale ? degraded_stale_ : degraded_busy_)++; }
+    void cacheHit() { cache_hits_++; }
+
+    size_t depth() const { return queue_.size(); }
+
+    // "name{labels} value" lines for the metrics command.
+    std::string metrics() const {
+        std::stringstream ss;
+        ss << "\nchatbox_admission_queue_depth " << queue_.size();
+        ss << "\nchatbox_admission_queue_capacity " << options_.queue_capacity;
+        ss << "\nchatbox_admission_admitted_total " << admitted_;
+        ss << "\nchatbox_admission_served_total " << served_;
+        ss << "\nchatbox_admission_cache_hits_total " << cache_hits_;
+        ss << "\nchatbox_admission_shed_total{reason=\"queue_full\"} " << count(Shed::QUEUE_FULL);
+        ss << "\nchatbox_admission_shed_total{reason=\"deadline\"} " << count(Shed::DEADLINE);
+        ss << "\nchatbox_admission_shed_total{reason=\"stalled\"} " << count(Shed::STALLED);
+        ss << "\nchatbox_admission_stalled_connections_total " << stalled_connections_;
+        ss << "\nchatbox_admission_degraded_total{answer=\"stale\"} " << degraded_stale_;
+        ss << "\nchatbox_admission_degraded_total{answer=\"busy\"} " << degraded_busy_;
+        for (const auto& c : cost_ms_) ss << "\nchatbox_admission_cost_ms{intent=\"" << c.first << "\"} " << c.second;
+        return ss.str();
+    }
+
+private:
+    double burstMs() const { return 1000 * options_.expensive_share; }
+
+    Clock::time_point latestStart(const Request& r) const {
+        double run_ms = std::min(r.cost_ms, options_.deadline_ms / 2);
+        return r.deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(run_ms));
+    }
+
+    void refill(Clock::time_point now) {
+        double elapsed = std::chrono::duration<double, std::milli>(now - refilled_).count();
+        tokens_ms_ = std::min(burstMs(), tokens_ms_ + elapsed * options_.expensive_share);
+        refilled_ = now;
+    }
+
+    size_t count(Shed reason) const {
+        auto it = shed_.find(reason);
+        return it == shed_.end() ? 0 : it->second;
+    }
+
+    AdmissionOptions options_;
+    std::deque<Request> queue_;
+    std::map<std::string, double> cost_ms_;
+    std::map<Shed, size_t> shed_;
+    double tokens_ms_ = 0;
+    Clock::time_point refilled_;
+    size_t admitted_ = 0;
+    size_t served_ = 0;
+    size_t cache_hits_ = 0;
+    size_t degraded_stale_ = 0;
+    size_t degraded_busy_ = 0;
+    size_t stalled_connections_ = 0;
+};
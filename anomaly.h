@@ -0,0 +1,123 @@
+#pragma once
+// Streaming haze-episode detector. Each series keeps an exponentially
+// weighted mean/variance and its current status band, so every reading is an
+// O(1) update. Alerts are raised when a reading crosses into a worse band or
+// jumps well above the series' recent behaviour, and are kept in an "active"
+// map that is read directly at query time. A band crossing stays active while
+// the band holds; a spike clears with the first reading that is not one.
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct AnomalyAlert {
+    enum Kind { BAND_CROSSING, SPIKE };
+
+    Kind kind;
+    std::string district;
+    std::string state;
+    std::string date;           // latest reading while the alert is active
+    std::string since;          // reading that raised it
+    double value;
+    double previous;            // reading before the one that raised it
+    int band_from;
+    int band_to;
+    double z_score;
+};
+
+struct AnomalyConfig {
+    double alpha = 0.2;         // EWMA weight of the newest reading
+    double z_threshold = 3.0;   // spike if value > mean + z * stddev
+    double min_jump = 15;       // ...and at least this many points above the mean
+    int warmup = 5;             // readings needed before spikes are flagged
+};
+
+class AnomalyDetector {
+public:
+    // `band_edges` are the inclusive upper bounds of each band except the
+    // last, e.g. {50, 100} for Good / Moderate / Unhealthy.
+    explicit AnomalyDetector(std::vector<double> band_edges = { 50, 100 }, AnomalyConfig config = AnomalyConfig())
+        : edges_(std::move(band_edges)), config_(config) {}
+
+    int bandOf(double value) const {
+        int band = 0;
+        while (band < static_cast<int>(edges_.size()) && value > edges_[band]) band++;
+        return band;
+    }
+
+    void observe(const std::string& district, const std::string& state, const std::string& date, double value) {
+        std::string key = district + "|" + state;
+        SeriesState& s = series_[key];
+        int band = bandOf(value);
+
+        if (s.count == 0) {
+            s.mean = value;
+            s.var = 0;
+            s.band = band;
+            s.last = value;
+            s.count = 1;
+            return;
+        }
+
+        double stddev = std::sqrt(s.var);
+        double z = stddev > 0 ? (value - s.mean) / stddev : 0;
+        bool spike = s.count >= config_.warmup && stddev > 0 &&
+            z >= config_.z_threshold && value - s.mean >= config_.min_jump;
+
+        if (band > s.band || spike) {
+            AnomalyAlert alert;
+            alert.kind = band > s.band ? AnomalyAlert::BAND_CROSSING : AnomalyAlert::SPIKE;
+            alert.district = district;
+            alert.state = state;
+            alert.date = date;
+            alert.since = date;
+            alert.value = value;
+            alert.previous = s.last;
+            alert.band_from = s.band;
+            alert.band_to = band;
+            alert.z_score = z;
+            active_[key] = alert;
+            raised_++;
+        }
+        else {
+            auto it = active_.find(key);
+            if (it != active_.end()) {
+                AnomalyAlert& alert = it->second;
+                if (alert.kind == AnomalyAlert::SPIKE || band < alert.band_to) active_.erase(it);
+                else {
+                    // Still in the worse band: show the latest reading.
+                    alert.value = value;
+                    alert.date = date;
+                }
+            }
+        }
+
+        double diff = value - s.mean;
+        double incr = config_.alpha * diff;
+        s.mean += incr;
+        s.var = (1 - config_.alpha) * (s.var + diff * incr);
+        s.band = band;
+        s.last = value;
+        s.count++;
+    }
+
+    const std::unordered_map<std::string, AnomalyAlert>& activeAlerts() const { return active_; }
+    size_t seriesCount() const { return series_.size(); }
+    size_t alertsRaised() const { return raised_; }
+
+private:
+    struct SeriesState {
+        double mean = 0;
+        double var = 0;
+        double last = 0;
+        int band = 0;
+        long count = 0;
+    };
+
+    std::vector<double> edges_;
+    AnomalyConfig config_;
+    std::unordered_map<std::string, SeriesState> series_;
+    std::unordered_map<std::string, AnomalyAlert> active_;
+    size_t raised_ = 0;
+};
@@ -0,0 +1,254 @@
+#pragma once
+// Write-ahead log for readings ingested at runtime. Each entry is
+//   u32 payload length | u32 CRC-32 of (seq, payload) | u64 seq | payload
+// (little-endian). Appends only queue the entry; a background flusher writes
+// everything queued so far and fsyncs it once, so concurrent or back-to-back
+// appends share one fsync (group commit). Without a waiter the flusher gives
+// a batch up to kCommitDelay to fill, so a steady stream of appends is not
+// cut into one fsync per entry. waitDurable(seq) blocks until an entry is on
+// disk. Replay stops at the first torn or corrupt entry (a crash
+// mid-write) and cuts the file there.
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+class AppendLog {
+public:
+    static const size_t kHeader = 16;
+    static const uint32_t kMaxEntry = 1u << 20;
+    static const size_t kBatchBytes = 1u << 20;      // commit at once past this much
+    static constexpr std::chrono::milliseconds kCommitDelay{ 2 };
+
+    ~AppendLog() { close(); }
+
+    static uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < n; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Flush a file's data to disk (used for checkpoints as well).
+    static bool syncPath(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) return false;
+        bool ok = syncFd(fd);
+        ::close(fd);
+        return ok;
+    }
+
+    // `next_seq` is the first sequence number to hand out when the log holds
+    // nothing newer. Read-only logs can only be replayed.
+    bool open(const std::string& path, uint64_t next_seq, bool read_only = false) {
+        path_ = path;
+        read_only_ = read_only;
+        next_seq_ = next_seq;
+        durable_seq_ = next_seq - 1;
+        fd_ = ::open(path.c_str(), read_only ? O_RDONLY : (O_RDWR | O_CREAT | O_APPEND), 0644);
+        return fd_ >= 0;
+    }
+
+    // fn(seq, payload) for every intact entry, in order. Returns the count.
+    size_t replay(const std::function<void(uint64_t, const std::string&)>& fn) {
+        if (fd_ < 0) return 0;
+        std::string data;
+        char buffer[1 << 16];
+        ::lseek(fd_, 0, SEEK_SET);
+        for (;;) {
+            auto n = ::read(fd_, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            data.append(buffer, static_cast<size_t>(n));
+        }
+
+        size_t pos = 0, count = 0;
+        while (pos + kHeader <= data.size()) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data()) + pos;
+            uint32_t length = get32(p), crc = get32(p + 4);
+            if (length > kMaxEntry || pos + kHeader + length > data.size()) break;
+            if (crc32(p + 8, 8 + length) != crc) break;
+            uint64_t seq = get64(p + 8);
+            fn(seq, data.substr(pos + kHeader, length));
+            if (seq >= next_seq_) next_seq_ = seq + 1;
+            pos += kHeader + length;
+            count++;
+        }
+        durable_seq_ = next_seq_ - 1;
+        bytes_ = pos;
+        entries_ = count;
+        if (pos < data.size() && !read_only_) {
+            // Torn tail from a crash: drop it so new entries follow the last good one.
+            if (ftruncateFd(fd_, pos) != 0) return count;
+            syncFd(fd_);
+        }
+        return count;
+    }
+
+    // Queue an entry for the next group commit; returns its sequence number.
+    uint64_t append(const std::string& payload) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!flusher_.joinable()) flusher_ = std::thread(&AppendLog::flushLoop, this);
+        uint64_t seq = next_seq_++;
+        size_t at = pending_.size();
+        pending_.resize(at + kHeader + payload.size());
+        uint8_t* p = reinterpret_cast<uint8_t*>(&pending_[at]);
+        put32(p, static_cast<uint32_t>(payload.size()));
+        put64(p + 8, seq);
+        memcpy(p + kHeader, payload.data(), payload.size());
+        put32(p + 4, crc32(p + 8, 8 + payload.size()));
+        pending_seq_ = seq;
+        entries_++;
+        if (at == 0 || pending_.size() >= kBatchBytes) wake_.notify_one();
+        return seq;
+    }
+
+    void waitDurable(uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (durable_seq_ >= seq) return;
+        waiters_++;
+        wake_.notify_one();
+        durable_.wait(lock, [&] { return durable_seq_ >= seq || failed_ || stop_; });
+        waiters_--;
+    }
+
+    void sync() {
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            last = next_seq_ - 1;
+        }
+        waitDurable(last);
+    }
+
+    // After a checkpoint: drop every entry (sequence numbers keep counting).
+    void truncate() {
+        sync();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ >= 0 && ftruncateFd(fd_, 0) == 0) syncFd(fd_);
+        bytes_ = 0;
+        entries_ = 0;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            wake_.notify_one();
+        }
+        if (flusher_.joinable()) flusher_.join();
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    uint64_t lastSeq() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return next_seq_ - 1;
+    }
+    size_t entries() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_;
+    }
+    size_t bytes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_ + pending_.size();
+    }
+    size_t commits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return commits_;
+    }
+    bool failed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+    const std::string& path() const { return path_; }
+
+private:
+    // Writes and fsyncs whatever has been queued since the last commit;
+    // entries queued during an fsync ride along with the next one.
+    void flushLoop() {
+        std::vector<char> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&] { return !pending_.empty() || stop_; });
+            if (pending_.empty() && stop_) return;
+            wake_.wait_for(lock, kCommitDelay,
+                [&] { return stop_ || waiters_ > 0 || pending_.size() >= kBatchBytes; });
+            batch.swap(pending_);
+            uint64_t seq = pending_seq_;
+            lock.unlock();
+
+            bool ok = writeAll(batch.data(), batch.size()) && syncFd(fd_);
+
+            lock.lock();
+            if (ok) {
+                bytes_ += batch.size();
+                durable_seq_ = seq;
+                commits_++;
+            }
+            else failed_ = true;
+            batch.clear();
+            durable_.notify_all();
+        }
+    }
+
+    bool writeAll(const char* data, size_t n) {
+        while (n > 0) {
+            auto written = ::write(fd_, data, static_cast<unsigned>(n));
+            if (written <= 0) return false;
+            data += written;
+            n -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    static bool syncFd(int fd) { return _commit(fd) == 0; }
+    static int ftruncateFd(int fd, size_t size) { return _chsize_s(fd, static_cast<long long>(size)); }
+#else
+    static bool syncFd(int fd) { return ::fsync(fd) == 0; }
+    static int ftruncateFd(int fd, size_t size) { return ::ftruncate(fd, static_cast<off_t>(size)); }
+#endif
+
+    static void put32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(v >> (8 * i)); }
+    static void put64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = static_cast<uint8_t>(v >> (8 * i)); }
+    static uint32_t get32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; i--) v = (v << 8) | p[i]; return v; }
+    static uint64_t get64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; i--) v = (v << 8) | p[i]; return v; }
+
+    std::string path_;
+    int fd_ = -1;
+    bool read_only_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable wake_, durable_;
+    std::thread flusher_;
+    std::vector<char> pending_;
+    uint64_t pending_seq_ = 0;
+    uint64_t next_seq_ = 1;
+    uint64_t durable_seq_ = 0;
+    size_t bytes_ = 0;
+    size_t entries_ = 0;
+    size_t commits_ = 0;
+    size_t waiters_ = 0;
+    bool failed_ = false;
+    bool stop_ = false;
+};
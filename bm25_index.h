@@ -0,0 +1,171 @@
+#pragma once
+// Inverted index with BM25 ranking for the knowledge base / FAQ corpus.
+// Each document has a short key phrase (weighted higher, like a title) and an
+// answer text. Per-posting BM25 impacts are precomputed at build time, and
+// queries use MaxScore pruning: once the common terms left to process cannot
+// lift an unseen document above the current best, they are only probed for
+// documents already in the running, instead of being scanned in full.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "memory_accounting.h"
+
+class Bm25Index {
+public:
+    struct Document {
+        TrackedString<MemSubsystem::STRINGS> key;
+        TrackedString<MemSubsystem::STRINGS> answer;
+    };
+
+    Bm25Index(double k1 = 1.2, double b = 0.75, int key_weight = 3) : k1_(k1), b_(b), key_weight_(key_weight) {}
+
+    // Adds a document; call build() before searching again.
+    size_t addDocument(const std::string& key, const std::string& answer) {
+        size_t id = docs_.size();
+        docs_.push_back({ { key.data(), key.size() }, { answer.data(), answer.size() } });
+
+        std::unordered_map<std::string, uint32_t> tf;
+        for (const auto& t : tokenize(key)) tf[t] += key_weight_;
+        for (const auto& t : tokenize(answer)) tf[t] += 1;
+
+        uint32_t length = 0;
+        for (const auto& pair : tf) {
+            terms_[pair.first].postings.push_back({ static_cast<uint32_t>(id), pair.second, 0.0f });
+            length += pair.second;
+        }
+        doc_length_.push_back(length);
+        built_ = false;
+        return id;
+    }
+
+    void build() {
+        double total = 0;
+        for (uint32_t len : doc_length_) total += len;
+        avg_length_ = docs_.empty() ? 0 : total / docs_.size();
+
+        double n = static_cast<double>(docs_.size());
+        for (auto& pair : terms_) {
+            Term& term = pair.second;
+            double df = static_cast<double>(term.postings.size());
+            double idf = std::log(1 + (n - df + 0.5) / (df + 0.5));
+            term.max_impact = 0;
+            for (Posting& p : term.postings) {
+                double tf = p.tf;
+                double norm = k1_ * (1 - b_ + b_ * doc_length_[p.doc] / avg_length_);
+                p.impact = static_cast<float>(idf * tf * (k1_ + 1) / (tf + norm));
+                term.max_impact = std::max(term.max_impact, p.impact);
+            }
+        }
+        scores_.assign(docs_.size(), 0.0f);
+        built_ = true;
+    }
+
+    // Best-scoring document for the query, or -1 when no query term is
+    // indexed. Ties go to the earlier document.
+    long search(const std::string& query, double* best_score = nullptr) {
+        if (!built_) build();
+
+        std::vector<const Term*> query_terms;
+        std::unordered_set<std::string> seen;
+        for (const auto& token : tokenize(query)) {
+            if (!seen.insert(token).second) continue;
+            auto it = terms_.find(token);
+            if (it != terms_.end()) query_terms.push_back(&it->second);
+        }
+        // Rarest (highest impact) terms first; remaining[i] bounds what terms
+        // i.. can still add to any document.
+        std::sort(query_terms.begin(), query_terms.end(),
+            [](const Term* a, const Term* b) { return a->max_impact > b->max_impact; });
+        std::vector<float> remaining(query_terms.size() + 1, 0.0f);
+        for (size_t i = query_terms.size(); i-- > 0;) remaining[i] = remaining[i + 1] + query_terms[i]->max_impact;
+
+        std::vector<uint32_t> touched;
+        float best_value = 0;
+        size_t i = 0;
+        for (; i < query_terms.size(); i++) {
+            if (!touched.empty() && remaining[i] < best_value) break;
+            for (const Posting& p : query_terms[i]->postings) {
+                if (scores_[p.doc] == 0.0f) touched.push_back(p.doc);
+                scores_[p.doc] += p.impact;
+                best_value = std::max(best_value, scores_[p.doc]);
+            }
+        }
+        // Pruned tail: only documents already touched can still win.
+        for (; i < query_terms.size(); i++) {
+            const auto& postings = query_terms[i]->postings;
+            for (uint32_t doc : touched) {
+                auto it = std::lower_bound(postings.begin(), postings.end(), doc,
+                    [](const Posting& p, uint32_t d) { return p.doc < d; });
+                if (it != postings.end() && it->doc == doc) scores_[doc] += it->impact;
+            }
+        }
+
+        long best = -1;
+        best_value = 0;
+        for (uint32_t doc : touched) {
+            if (scores_[doc] > best_value || (scores_[doc] == best_value && static_cast<long>(doc) < best)) {
+                best_value = scores_[doc];
+                best = doc;
+            }
+            scores_[doc] = 0.0f;   // reset only what this query touched
+        }
+        if (best_score) *best_score = best_value;
+        return best;
+    }
+
+    const Document& document(size_t id) const { return docs_[id]; }
+    size_t size() const { return docs_.size(); }
+
+    static std::vector<std::string> tokenize(const std::string& text) {
+        static const std::unordered_set<std::string> stopwords = {
+            "a", "an", "the", "is", "are", "was", "were", "be", "to", "of", "in", "on", "at", "for",
+            "and", "or", "it", "i", "me", "my", "you", "your", "can", "do", "does", "what", "how",
+            "with", "about", "this", "that", "there", "please", "tell"
+        };
+        std::vector<std::string> tokens;
+        std::string word;
+        auto flush = [&]() {
+            if (word.empty()) return;
+            bool single_letter = word.size() == 1 && isalpha(static_cast<unsigned char>(word[0]));
+            if (!single_letter && !stopwords.count(word)) {
+                // Light plural folding: "masks" -> "mask"; short words and "-ss" endings are kept.
+                if (word.size() > 3 && word.back() == 's' && word[word.size() - 2] != 's') word.pop_back();
+                tokens.push_back(word);
+            }
+            word.clear();
+        };
+        for (char c : text) {
+            if (isalnum(static_cast<unsigned char>(c))) word += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            else flush();
+        }
+        flush();
+        return tokens;
+    }
+
+private:
+    struct Posting {
+        uint32_t doc;
+        uint32_t tf;
+        float impact;     // precomputed BM25 contribution
+    };
+
+    struct Term {
+        TrackedVector<Posting, MemSubsystem::INDEXES> postings;   // sorted by doc id
+        float max_impact = 0;
+    };
+
+    double k1_, b_;
+    int key_weight_;
+    bool built_ = false;
+    double avg_length_ = 0;
+    TrackedVector<Document, MemSubsystem::STRINGS> docs_;
+    TrackedVector<uint32_t, MemSubsystem::INDEXES> doc_length_;
+    std::unordered_map<std::string, Term, std::hash<std::string>, std::equal_to<std::string>,
+        TrackingAllocator<std::pair<const std::string, Term>, MemSubsystem::INDEXES>> terms_;
+    TrackedVector<float, MemSubsystem::INDEXES> scores_;
+};
@@ -0,0 +1,199 @@
+#pragma once
+// Terminal and SVG chart rendering for metric series. Long series are reduced
+// with Largest-Triangle-Three-Buckets before drawing, so render cost depends
+// on the output size rather than the history length.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct ChartPoint {
+    double x;
+    double y;
+};
+
+// Largest-Triangle-Three-Buckets: keeps the first and last point and, for
+// each bucket in between, the point forming the largest triangle with the
+// previously kept point and the average of the next bucket. O(n).
+inline std::vector<ChartPoint> lttbDownsample(const std::vector<ChartPoint>& data, size_t threshold) {
+    if (threshold >= data.size() || threshold < 3) return data;
+
+    std::vector<ChartPoint> sampled;
+    sampled.reserve(threshold);
+    double every = static_cast<double>(data.size() - 2) / (threshold - 2);
+
+    size_t a = 0;
+    sampled.push_back(data[a]);
+    for (size_t i = 0; i < threshold - 2; i++) {
+        size_t avg_start = static_cast<size_t>(std::floor((i + 1) * every)) + 1;
+        size_t avg_end = std::min(static_cast<size_t>(std::floor((i + 2) * every)) + 1, data.size());
+        double avg_x = 0, avg_y = 0;
+        for (size_t j = avg_start; j < avg_end; j++) {
+            avg_x += data[j].x;
+            avg_y += data[j].y;
+        }
+        size_t avg_len = avg_end > avg_start ? avg_end - avg_start : 1;
+        if (avg_end <= avg_start) { avg_x = data.back().x; avg_y = data.back().y; }
+        else { avg_x /= avg_len; avg_y /= avg_len; }
+
+        size_t range_start = static_cast<size_t>(std::floor(i * every)) + 1;
+        size_t range_end = static_cast<size_t>(std::floor((i + 1) * every)) + 1;
+        double max_area = -1;
+        size_t next_a = range_start;
+        for (size_t j = range_start; j < range_end; j++) {
+            double area = std::fabs((data[a].x - avg_x) * (data[j].y - data[a].y) -
+                (data[a].x - data[j].x) * (avg_y - data[a].y));
+            if (area > max_area) {
+                max_area = area;
+                next_a = j;
+            }
+        }
+        sampled.push_back(data[next_a]);
+        a = next_a;
+    }
+    sampled.push_back(data.back());
+    return sampled;
+}
+
+inline void appendUtf8(std::string& out, unsigned int cp) {
+    if (cp < 0x80) out += static_cast<char>(cp);
+    else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// One-line block sparkline, e.g. ▂▃▅▇▅▃.
+inline std::string renderSparkline(const std::vector<ChartPoint>& data, size_t width = 40) {
+    if (data.empty()) return "";
+    std::vector<ChartPoint> pts = lttbDownsample(data, width);
+    double lo = pts[0].y, hi = pts[0].y;
+    for (const auto& p : pts) { lo = std::min(lo, p.y); hi = std::max(hi, p.y); }
+
+    std::string out;
+    for (const auto& p : pts) {
+        int level = hi > lo ? static_cast<int>(std::lround((p.y - lo) / (hi - lo) * 7)) : 3;
+        appendUtf8(out, 0x2581 + level);
+    }
+    return out;
+}
+
+// Multi-line braille line plot (2x4 dots per character cell) with a y-axis.
+inline std::string renderBraillePlot(const std::vector<ChartPoint>& data, int width = 60, int height = 8) {
+    if (data.empty()) return "";
+    int dots_w = width * 2, dots_h = height * 4;
+    std::vector<ChartPoint> pts = lttbDownsample(data, dots_w);
+
+    double min_x = pts.front().x, max_x = pts.back().x;
+    double lo = pts[0].y, hi = pts[0].y;
+    for (const auto& p : pts) { lo = std::min(lo, p.y); hi = std::max(hi, p.y); }
+    if (hi == lo) { hi += 1; lo -= 1; }
+
+    std::vector<unsigned char> cells(width * height, 0);
+    static const unsigned char dot_bits[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+    auto plot = [&](int dx, int dy) {
+        if (dx < 0 || dx >= dots_w || dy < 0 || dy >= dots_h) return;
+        cells[(dy / 4) * width + dx / 2] |= dot_bits[dy % 4][dx % 2];
+    };
+    auto to_dot = [&](const ChartPoint& p, int& dx, int& dy) {
+        dx = max_x > min_x ? static_cast<int>(std::lround((p.x - min_x) / (max_x - min_x) * (dots_w - 1))) : 0;
+        dy = static_cast<int>(std::lround((hi - p.y) / (hi - lo) * (dots_h - 1)));
+    };
+
+    int px, py;
+    to_dot(pts[0], px, py);
+    plot(px, py);
+    for (size_t i = 1; i < pts.size(); i++) {
+        int qx, qy;
+        to_dot(pts[i], qx, qy);
+        // Bresenham line between consecutive samples.
+        int dx = std::abs(qx - px), sx = px < qx ? 1 : -1;
+        int dy = -std::abs(qy - py), sy = py < qy ? 1 : -1;
+        int err = dx + dy, x = px, y = py;
+        while (true) {
+            plot(x, y);
+            if (x == qx && y == qy) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x += sx; }
+            if (e2 <= dx) { err += dx; y += sy; }
+        }
+        px = qx;
+        py = qy;
+    }
+
+    std::string out;
+    char label[16];
+    for (int row = 0; row < height; row++) {
+        if (row == 0) snprintf(label, sizeof(label), "%6.0f ┤", hi);
+        else if (row == height - 1) snprintf(label, sizeof(label), "%6.0f ┤", lo);
+        else snprintf(label, sizeof(label), "       │");
+        out += label;
+        for (int col = 0; col < width; col++) appendUtf8(out, 0x2800 + cells[row * width + col]);
+        out += "\n";
+    }
+    return out;
+}
+
+// Standalone SVG line chart. `guides` draws dashed horizontal reference
+// lines (e.g. the 50/100 API band edges) when they fall inside the range.
+inline std::string renderSvg(const std::vector<ChartPoint>& data, const std::string& title,
+    const std::vector<double>& guides = {}, int width = 800, int height = 300, size_t max_points = 400) {
+    std::vector<ChartPoint> pts = lttbDownsample(data, max_points);
+    const int pad = 40;
+    double min_x = pts.empty() ? 0 : pts.front().x, max_x = pts.empty() ? 1 : pts.back().x;
+    double lo = 0, hi = 1;
+    if (!pts.empty()) {
+        lo = hi = pts[0].y;
+        for (const auto& p : pts) { lo = std::min(lo, p.y); hi = std::max(hi, p.y); }
+    }
+    if (hi == lo) { hi += 1; lo -= 1; }
+    if (max_x == min_x) max_x = min_x + 1;
+
+    auto sx = [&](double x) { return pad + (x - min_x) / (max_x - min_x) * (width - 2 * pad); };
+    auto sy = [&](double y) { return height - pad - (y - lo) / (hi - lo) * (height - 2 * pad); };
+
+    std::string svg;
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+        width, height, width, height);
+    svg += buf;
+    svg += "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+    std::string escaped;
+    for (char c : title) {
+        if (c == '<') escaped += "&lt;";
+        else if (c == '>') escaped += "&gt;";
+        else if (c == '&') escaped += "&amp;";
+        else escaped += c;
+    }
+    snprintf(buf, sizeof(buf), "<text x=\"%d\" y=\"20\" font-family=\"sans-serif\" font-size=\"14\">", pad);
+    svg += buf + escaped + "</text>\n";
+    snprintf(buf, sizeof(buf), "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"#999\"/>\n",
+        pad, height - pad, width - pad, height - pad);
+    svg += buf;
+    snprintf(buf, sizeof(buf), "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"#999\"/>\n",
+        pad, pad, pad, height - pad);
+    svg += buf;
+    snprintf(buf, sizeof(buf), "<text x=\"4\" y=\"%.1f\" font-size=\"10\">%.0f</text>\n"
+        "<text x=\"4\" y=\"%.1f\" font-size=\"10\">%.0f</text>\n", sy(hi) + 4, hi, sy(lo) + 4, lo);
+    svg += buf;
+    for (double g : guides) {
+        if (g <= lo || g >= hi) continue;
+        snprintf(buf, sizeof(buf), "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#e88\" stroke-dasharray=\"4 4\"/>\n",
+            pad, sy(g), width - pad, sy(g));
+        svg += buf;
+    }
+    svg += "<polyline fill=\"none\" stroke=\"#2a6fdb\" stroke-width=\"1.5\" points=\"";
+    for (size_t i = 0; i < pts.size(); i++) {
+        snprintf(buf, sizeof(buf), "%s%.1f,%.1f", i ? " " : "", sx(pts[i].x), sy(pts[i].y));
+        svg += buf;
+    }
+    svg += "\"/>\n</svg>\n";
+    return svg;
+}
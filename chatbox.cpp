@@ -9,12 +9,39 @@
 #include <fstream>
 #include <iomanip>
 #include <regex>
+#include <set>
+#include <list>
+#include <functional>
+#include <chrono>
+#include "parquet_reader.h"
+#include "series_align.h"
+#include "chart.h"
+#include "forecast.h"
+#include "anomaly.h"
+#include "spatial_index.h"
+#include "bm25_index.h"
+#include "intent_classifier.h"
+#include "partition_store.h"
+#include "query_plan.h"
+#include "memory_accounting.h"
+#include "quantile_sketch.h"
+#include "query_answer.h"
+#include "shard_cluster.h"
+#include "append_log.h"
+#include "load_generator.h"
+#include "admission_control.h"
+#include "latest_view.h"
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 // --- Cross-Platform Keyboard Input Setup ---
 #ifdef _WIN32
 #include <conio.h>
+#include <direct.h>
 #define ESC_KEY 27
+int make_directory(const char* path) { return _mkdir(path); }
 void set_raw_mode() {}
 void restore_mode() {}
 int get_key_press() { return _kbhit() ? _getch() : 0; }
@@ -22,8 +49,20 @@ int get_key_press() { return _kbhit() ? _getch() : 0; }
 #include <termios.h>
 #include <unistd.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <csignal>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 #define ESC_KEY 27
 
+int make_directory(const char* path) { return mkdir(path, 0755); }
+
 struct termios original_terminal_settings;
 
 void set_raw_mode() {
@@ -66,18 +105,204 @@ struct APIData {
 
 class AirPollutantAI {
 private:
-    map<string, string> knowledge_base_;
+    Bm25Index knowledge_index_;
+    IntentClassifier intent_model_;
+    // The keyword router answers first; a prediction is used when no keyword
+    // rule matches, or instead of a match when it is at least kIntentOverride.
+    static constexpr float kIntentConfidence = 0.6f;
+    static constexpr float kIntentOverride = 0.95f;
+
+    // Month partitions (when the data source is a partition directory).
+    // api_data_ holds the resident partitions as contiguous segments in
+    // load order, followed by readings ingested at runtime.
+    bool partitioned_ = false;
+    PartitionManifest partitions_;
+    vector<size_t> resident_segments_;       // partition indexes in api_data_ order
+    size_t ingested_tail_ = 0;               // runtime readings after the segments
+    uint64_t partition_clock_ = 0;
+    size_t partition_budget_bytes_ = 64u << 20;
+    static const size_t kHotPartitions = 2;  // newest months stay resident
+    static const size_t kAreaMonths = 2;     // months an area's history answer covers
+
+    // Recent answers keyed by lowercase message, most recent first; cleared
+    // when new readings arrive or partitions are loaded or evicted.
+    using CachedText = TrackedString<MemSubsystem::CACHES>;
+    using CacheEntries = list<pair<CachedText, CachedText>, TrackingAllocator<pair<CachedText, CachedText>, MemSubsystem::CACHES>>;
+    CacheEntries response_cache_;
+    unordered_map<CachedText, CacheEntries::iterator, TrackedStringHash, equal_to<CachedText>,
+        TrackingAllocator<pair<const CachedText, CacheEntries::iterator>, MemSubsystem::CACHES>> response_cache_index_;
+    // Answers made out of date by new readings; the server falls back to
+    // them when it sheds a request under overload.
+    unordered_map<CachedText, CachedText, TrackedStringHash, equal_to<CachedText>,
+        TrackingAllocator<pair<const CachedText, CachedText>, MemSubsystem::CACHES>> stale_answers_;
+    static const size_t kStaleAnswers = 256;
+    const AdmissionControl* admission_ = nullptr;   // server mode: exposed in metrics
+    size_t cache_budget_bytes_ = 4u << 20;
+    size_t memory_budget_bytes_ = 256u << 20;   // all tracked subsystems
+    size_t cache_evictions_ = 0;
+    size_t partition_evictions_ = 0;
+
+    // Long listings are rendered a page at a time from a cursor that holds
+    // the typed answer's records, never the whole rendered text.
+    struct PageCursor {
+        string header;                  // sent with the first page
+        string footer;                  // sent after the last row
+        size_t total = 0;
+        size_t next = 0;
+        function<string(size_t)> row;   // renders row i
+        bool active() const { return next < total; }
+    };
+    static const size_t kPageSize = 20;
+    PageCursor cursor_;
+    bool paged_response_ = false;    // this answer opened a cursor; do not cache it
+    bool wrote_file_ = false;        // this answer saved a file; do not cache it
+    bool streaming_ = false;         // server mode: pages go out as chunks, no prompts
+
+    // Typed answer behind the latest response, set by present().
+    QueryAnswer answer_;
+    bool answered_ = false;
     vector<string> default_responses_;
-    vector<APIData> api_data_;
+    TrackedVector<APIData, MemSubsystem::RECORDS> api_data_;
+    ColumnTable table_;                      // columnar mirror of api_data_ for query plans
+    bool table_dirty_ = true;
+    ForecastEngine forecaster_;
+    QuantileStore quantiles_;
+    LatestConditionsView latest_;            // newest reading per station, kept at load and ingest
+
+    // Sharded mode. A coordinator sends query plans, percentile sketches and
+    // reading lookups to the shard workers and keeps no rows of its own
+    // besides readings not yet checkpointed: loading only numbers the rows,
+    // notes each area and collects per-area series for the forecast and
+    // alert builds. A worker streams the data file and keeps its shard, with
+    // global_rows_ mapping its rows to rows of the full data file.
+    ShardCluster* shards_ = nullptr;
+    TrackedVector<size_t, MemSubsystem::RECORDS> global_rows_;
+    size_t shard_ = 0;
+    size_t shard_count_ = 0;                 // worker: keeps rows of shard_ of shard_count_
+    size_t loaded_rows_ = 0;                 // global row ids handed out so far
+    vector<pair<string, string>> area_order_;   // coordinator: areas in first-seen order
+    unordered_set<string> area_seen_;
+    map<string, ForecastEngine::SeriesInput> loaded_series_;   // coordinator, until the builds
+
+    // Write-ahead log of readings ingested at runtime (<data file>.wal),
+    // created on the first ingest. A text data file doubles as the snapshot:
+    // a checkpoint appends the logged readings to it between
+    // "# checkpoint-begin/end <seq>" lines and empties the log, so startup
+    // replays only what came after the last checkpoint.
+    unique_ptr<AppendLog> log_;
+    string log_path_;
+    string snapshot_file_;                   // the text data file, or the sidecar of Parquet and partitioned sources
+    uint64_t checkpoint_seq_ = 0;            // newest log entry folded into the snapshot
+    size_t unsaved_rows_ = 0;                // rows at the end of api_data_ not yet in the snapshot
+    static const size_t kCheckpointEntries = 1u << 20;
+    AnomalyDetector detector_;
+    vector<GeoPoint> places_;                        // every named location with coordinates
+    unordered_map<string, size_t> place_lookup_;     // lowercase name -> places_ index
+    vector<GeoPoint> stations_;                      // places that have API readings
+    KdTree station_index_;
 
 public:
-    AirPollutantAI() {
+    AirPollutantAI(const string& data_file = "malaysia_api_1month_daily.txt", ShardCluster* shards = nullptr) : shards_(shards) {
         srand(time(0));
-        loadAPIData("malaysia_api_1month_daily.txt");
+        loadAPIData(data_file);
+        log_path_ = data_file + ".wal";
+        if (ifstream(log_path_).good()) {
+            log_.reset(new AppendLog());
+            if (!log_->open(log_path_, checkpoint_seq_ + 1)) {
+                cerr << "Warning: Could not open log " << log_path_ << endl;
+                log_.reset();
+            }
+            else {
+                size_t replayed = replayLog(*log_);
+                if (replayed) cout << "Replayed " << replayed << " logged readings.\n";
+            }
+        }
+        loadStationMetadata("malaysia_stations.txt");
         initializeKnowledgeBase();
+        if (!intent_model_.load("intent_model.bin")) {
+            cerr << "Warning: Could not load intent_model.bin, using keyword routing only" << endl;
+        }
+        buildAlertState();       // before the forecast fit consumes the loaded series
+        buildForecastModels();
+        if (!shards_) buildLatestView();   // a coordinator's view is filled while loading
+        if (!partitioned_ && !shards_) buildQuantileSketches();
     }
 
-    void loadAPIData(const string& filename) {
+    void buildLatestView() {
+        for (const auto& data : api_data_) updateLatest(data);
+    }
+
+    void updateLatest(const APIData& data) {
+        latest_.update(data.district, data.state, data.apiReading, data.status, data.date, dateToDayNumber(data.date));
+    }
+
+    // Shard worker: the readings whose state hashes to `shard`, kept as the
+    // file and log are read, with the query table and sketches built over them.
+    AirPollutantAI(const string& data_file, size_t shard, size_t shard_count) : shard_(shard), shard_count_(shard_count) {
+        loadAPIData(data_file);
+        AppendLog log;   // the coordinator owns the log; workers only replay it
+        if (log.open(data_file + ".wal", checkpoint_seq_ + 1, true)) replayLog(log);
+        api_data_.shrink_to_fit();
+        columns();
+        buildQuantileSketches();
+    }
+
+    // A reading from the data file or the log, numbered with the next global
+    // row id. A shard worker keeps it only when its state hashes to the
+    // worker's shard. A coordinator keeps its area, latest reading and series
+    // point, and the row itself only when `keep` (replayed readings the next
+    // checkpoint still has to write).
+    void addRecord(APIData&& record, bool keep = false) {
+        size_t row = loaded_rows_++;
+        if (shard_count_) {
+            if (ShardCluster::shardOf(record.state, shard_count_) != shard_) return;
+            global_rows_.push_back(row);
+        }
+        else if (shards_) {
+            noteArea(record.district, record.state);
+            updateLatest(record);
+            addToSeries(loaded_series_, record);
+            if (!keep) return;
+        }
+        api_data_.push_back(move(record));
+    }
+
+    void noteArea(const string& district, const string& state) {
+        if (area_seen_.insert(district + "|" + state).second) area_order_.push_back({ district, state });
+    }
+
+    // Readings in the store: every loaded row for a coordinator, which
+    // keeps only the unsaved ones.
+    size_t recordCount() const { return shards_ ? loaded_rows_ : api_data_.size(); }
+
+    // Partitioned data is folded in as each partition is first loaded.
+    void buildQuantileSketches() {
+        for (const auto& data : api_data_) {
+            quantiles_.add(data.district, data.state, dateToDayNumber(data.date), static_cast<float>(data.apiReading));
+        }
+    }
+
+    // Fit one forecast model per district over the loaded history.
+    void buildForecastModels() {
+        map<string, ForecastEngine::SeriesInput> inputs;
+        inputs.swap(loaded_series_);   // a coordinator's history is only here
+        if (!shards_) for (const auto& data : api_data_) addToSeries(inputs, data);
+        forecaster_.fit(inputs);
+    }
+
+    static void addToSeries(map<string, ForecastEngine::SeriesInput>& inputs, const APIData& data) {
+        auto& input = inputs[data.district + "|" + data.state];
+        if (input.readings.empty()) {
+            input.district = data.district;
+            input.state = data.state;
+        }
+        input.readings.push_back({ dateToDayNumber(data.date), static_cast<double>(data.apiReading) });
+    }
+
+    // Load "name,state,lat,lon" lines. Names that match a district in the API
+    // data become stations in the spatial index; the rest are places that
+    // resolve to their nearest stations.
+    void loadStationMetadata(const string& filename) {
         ifstream file(filename);
         if (!file.is_open()) {
             cerr << "Warning: Could not open file " << filename << endl;
@@ -87,47 +312,669 @@ public:
         string line;
         while (getline(file, line)) {
             if (line.empty() || line[0] == '#') continue;
+            stringstream ls(line);
+            GeoPoint p;
+            string lat, lon;
+            if (!getline(ls, p.name, ',') || !getline(ls, p.state, ',') ||
+                !getline(ls, lat, ',') || !getline(ls, lon, ',')) continue;
+            try {
+                p.lat = stod(lat);
+                p.lon = stod(lon);
+            }
+            catch (...) { continue; }
+
+            string key = p.name;
+            transform(key.begin(), key.end(), key.begin(), ::tolower);
+            if (place_lookup_.count(key)) continue;
+            place_lookup_[key] = places_.size();
+            places_.push_back(p);
+        }
+        buildStationIndex();
+    }
+
+    void buildStationIndex() {
+        unordered_set<string> monitored;
+        for (const auto& data : api_data_) {
+            string key = data.district;
+            transform(key.begin(), key.end(), key.begin(), ::tolower);
+            monitored.insert(key);
+        }
+        for (const auto& area : area_order_) {
+            string key = area.first;
+            transform(key.begin(), key.end(), key.begin(), ::tolower);
+            monitored.insert(key);
+        }
+        for (const auto& p : partitions_.partitions()) {
+            for (string key : p.districts) {
+                transform(key.begin(), key.end(), key.begin(), ::tolower);
+                monitored.insert(key);
+            }
+        }
+
+        stations_.clear();
+        for (const auto& p : places_) {
+            string key = p.name;
+            transform(key.begin(), key.end(), key.begin(), ::tolower);
+            if (monitored.count(key)) stations_.push_back(p);
+        }
+        station_index_.build(stations_);
+    }
+
+    // Replay the loaded history through the anomaly detector in date order.
+    // Areas are independent, so a coordinator replays each loaded series on
+    // its own.
+    void buildAlertState() {
+        if (shards_) {
+            for (auto& series : loaded_series_) {
+                auto& readings = series.second.readings;
+                stable_sort(readings.begin(), readings.end(),
+                    [](const pair<int, double>& a, const pair<int, double>& b) { return a.first < b.first; });
+                for (const auto& r : readings) {
+                    detector_.observe(series.second.district, series.second.state, dayNumberToDate(r.first), static_cast<int>(r.second));
+                }
+            }
+            return;
+        }
+        vector<size_t> order(api_data_.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        stable_sort(order.begin(), order.end(),
+            [this](size_t a, size_t b) { return api_data_[a].date < api_data_[b].date; });
+        for (size_t i : order) {
+            const APIData& data = api_data_[i];
+            detector_.observe(data.district, data.state, data.date, data.apiReading);
+        }
+    }
+
+    // Add a reading that arrived after startup. It is queued on the log
+    // first and durable once waitDurable(seq) or syncLog() returns; forecast
+    // and alert state are updated in O(1).
+    uint64_t ingestReading(const APIData& record) {
+        uint64_t seq = 0;
+        if (AppendLog* log = appendLog()) seq = log->append(formatAPIDataLine(record));
+        applyReading(record);
+        if (log_ && log_->entries() >= kCheckpointEntries) checkpoint();
+        return seq;
+    }
+
+    void waitDurable(uint64_t seq) { if (log_) log_->waitDurable(seq); }
+    void syncLog() { if (log_) log_->sync(); }
+
+    AppendLog* appendLog() {
+        if (!log_ && !log_path_.empty()) {
+            log_.reset(new AppendLog());
+            if (!log_->open(log_path_, checkpoint_seq_ + 1)) {
+                cerr << "Warning: Could not open log " << log_path_ << ", readings are not durable" << endl;
+                log_path_.clear();
+                log_.reset();
+            }
+        }
+        return log_.get();
+    }
 
+    // Fold the logged readings into the snapshot and empty the log. The
+    // block only counts once its end line is on disk; until then the log
+    // still holds every reading in it.
+    bool checkpoint() {
+        if (!log_ || snapshot_file_.empty()) return false;
+        log_->sync();
+        uint64_t seq = log_->lastSeq();
+        if (seq <= checkpoint_seq_) return true;
+
+        ofstream out(snapshot_file_, ios::app | ios::binary);
+        out << "\n# checkpoint-begin " << seq << "\n";   // never continues a torn last line
+        for (size_t i = api_data_.size() - unsaved_rows_; i < api_data_.size(); i++) out << formatAPIDataLine(api_data_[i]) << "\n";
+        out << "# checkpoint-end " << seq << "\n";
+        out.close();
+        if (out.fail() || !AppendLog::syncPath(snapshot_file_)) {
+            cerr << "Warning: Could not checkpoint into " << snapshot_file_ << endl;
+            return false;
+        }
+        checkpoint_seq_ = seq;
+        unsaved_rows_ = 0;
+        if (shards_) api_data_.clear();   // the workers hold the rows now in the snapshot
+        log_->truncate();
+        return true;
+    }
+
+    // Readings logged after the last checkpoint, applied like snapshot rows
+    // (the forecast, alert and sketch builds that follow include them).
+    size_t replayLog(AppendLog& log) {
+        size_t applied = 0;
+        log.replay([&](uint64_t seq, const string& payload) {
+            if (seq <= checkpoint_seq_) return;   // crashed between checkpoint and truncate
             APIData record;
-            size_t pos = 0;
-            string token;
-            int fieldCount = 0;
-            string tempLine = line;
-
-            while ((pos = tempLine.find(',')) != string::npos) {
-                token = tempLine.substr(0, pos);
-                switch (fieldCount) {
-                case 0: record.district = token; break;
-                case 1: record.state = token; break;
-                case 2:
-                    try { record.apiReading = stoi(token); }
-                    catch (...) { record.apiReading = 0; }
-                    break;
-                case 3: record.status = token; break;
+            parseAPIDataLine(payload, record);
+            if (partitioned_) addTailRecord(move(record));
+            else addRecord(move(record), true);
+            unsaved_rows_++;
+            applied++;
+        });
+        return applied;
+    }
+
+    // A reading kept after the partition segments (partitioned sources).
+    void addTailRecord(APIData&& record) {
+        quantiles_.add(record.district, record.state, dateToDayNumber(record.date), static_cast<float>(record.apiReading));
+        api_data_.push_back(move(record));
+        ingested_tail_++;
+    }
+
+    void applyReading(const APIData& record) {
+        api_data_.push_back(record);
+        unsaved_rows_++;
+        size_t row = loaded_rows_++;
+        if (partitioned_) ingested_tail_++;
+        updateLatest(record);
+        invalidateResponseCache();
+        forecaster_.observe(record.district + "|" + record.state, record.district, record.state,
+            dateToDayNumber(record.date), record.apiReading);
+        detector_.observe(record.district, record.state, record.date, record.apiReading);
+        if (shards_) {
+            noteArea(record.district, record.state);
+            shards_->ingest(record.district, record.state, record.apiReading, record.status, record.date,
+                dateToDayNumber(record.date), row);
+            return;
+        }
+        if (!table_dirty_ && table_.size() + 1 == api_data_.size()) appendColumns(record);
+        quantiles_.add(record.district, record.state, dateToDayNumber(record.date), static_cast<float>(record.apiReading));
+    }
+
+    // Parquet files and partition directories are not rewritten; their
+    // checkpoints go to a text sidecar next to them, read after the source.
+    void loadAPIData(const string& filename) {
+        if (filename.size() > 8 && filename.compare(filename.size() - 8, 8, ".parquet") == 0) {
+            loadParquetData(filename);
+            loadTextData(filename + ".checkpoint", true);
+            return;
+        }
+        if (PartitionManifest::exists(filename)) {
+            openPartitions(filename);
+            loadTextData(filename + ".checkpoint", true);
+            return;
+        }
+        loadTextData(filename, false);
+    }
+
+    // A text data file, or a checkpoint sidecar (absent until the first
+    // checkpoint, and holding only checkpoint blocks).
+    void loadTextData(const string& filename, bool sidecar) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            if (sidecar) snapshot_file_ = filename;
+            else cerr << "Warning: Could not open file " << filename << endl;
+            return;
+        }
+
+        // Checkpoint blocks count only when complete, so their rows wait in
+        // `block` until the end line; an unfinished one is still in the log.
+        string line;
+        vector<APIData> block;
+        bool in_block = false;
+        while (getline(file, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '#') {
+                if (line.compare(0, 19, "# checkpoint-begin ") == 0) {
+                    block.clear();
+                    in_block = true;
                 }
-                tempLine.erase(0, pos + 1);
-                fieldCount++;
+                else if (line.compare(0, 17, "# checkpoint-end ") == 0 && in_block) {
+                    checkpoint_seq_ = max<uint64_t>(checkpoint_seq_, strtoull(line.c_str() + 17, nullptr, 10));
+                    for (auto& record : block) {
+                        if (partitioned_) addTailRecord(move(record));
+                        else addRecord(move(record));
+                    }
+                    block.clear();
+                    in_block = false;
+                }
+                continue;
             }
-            record.date = tempLine;
-            api_data_.push_back(record);
+
+            APIData record;
+            parseAPIDataLine(line, record);
+            if (in_block) block.push_back(move(record));
+            else if (!sidecar) addRecord(move(record));
         }
         file.close();
-        cout << "Loaded " << api_data_.size() << " air quality records.\n";
+        snapshot_file_ = filename;
+        if (!sidecar) cout << "Loaded " << loaded_rows_ << " air quality records.\n";
+    }
+
+    static string formatAPIDataLine(const APIData& record) {
+        return record.district + "," + record.state + "," + to_string(record.apiReading) + "," + record.status + "," + record.date;
+    }
+
+    // "district,state,api,status,date"
+    static void parseAPIDataLine(const string& line, APIData& record) {
+        size_t pos = 0;
+        string token;
+        int fieldCount = 0;
+        string tempLine = line;
+
+        while ((pos = tempLine.find(',')) != string::npos) {
+            token = tempLine.substr(0, pos);
+            switch (fieldCount) {
+            case 0: record.district = token; break;
+            case 1: record.state = token; break;
+            case 2:
+                try { record.apiReading = stoi(token); }
+                catch (...) { record.apiReading = 0; }
+                break;
+            case 3: record.status = token; break;
+            }
+            tempLine.erase(0, pos + 1);
+            fieldCount++;
+        }
+        record.date = tempLine;
+    }
+
+    // Split the loaded data into one file per month plus a manifest.
+    bool writePartitions(const string& dir) {
+        if (api_data_.empty()) {
+            cerr << "Warning: No records to partition" << endl;
+            return false;
+        }
+        make_directory(dir.c_str());
+
+        map<string, vector<const APIData*>> by_month;
+        for (const auto& data : api_data_) {
+            if (data.date.size() < 7) continue;
+            by_month[data.date.substr(0, 7)].push_back(&data);
+        }
+
+        PartitionManifest manifest;
+        for (const auto& month : by_month) {
+            PartitionInfo info;
+            info.month = month.first;
+            info.file = month.first + ".txt";
+            info.first_date = info.last_date = month.second.front()->date;
+            set<pair<string, string>> areas;
+
+            ofstream out(dir + "/" + info.file);
+            if (!out.is_open()) {
+                cerr << "Warning: Could not write " << dir << "/" << info.file << endl;
+                return false;
+            }
+            for (const APIData* data : month.second) {
+                out << data->district << "," << data->state << "," << data->apiReading << ","
+                    << data->status << "," << data->date << "\n";
+                info.first_date = min(info.first_date, data->date);
+                info.last_date = max(info.last_date, data->date);
+                areas.insert({ data->district, data->state });
+            }
+            info.rows = month.second.size();
+            for (const auto& area : areas) {
+                info.districts.push_back(area.first);
+                info.states.push_back(area.second);
+            }
+            manifest.partitions().push_back(info);
+        }
+        if (!manifest.save(dir)) {
+            cerr << "Warning: Could not write " << PartitionManifest::manifestPath(dir) << endl;
+            return false;
+        }
+        cout << "Wrote " << by_month.size() << " partitions to " << dir << "\n";
+        return true;
+    }
+
+    // Open a partition directory: only the newest months are loaded now,
+    // older ones when a query needs them.
+    void openPartitions(const string& dir) {
+        if (!partitions_.load(dir) || partitions_.partitions().empty()) {
+            cerr << "Warning: Could not read partition manifest in " << dir << endl;
+            return;
+        }
+        partitioned_ = true;
+        size_t count = partitions_.partitions().size();
+        for (size_t i = count > kHotPartitions ? count - kHotPartitions : 0; i < count; i++) loadPartition(i);
+        cout << "Opened " << count << " partitions from " << dir << " (" << api_data_.size()
+            << " records resident).\n";
+    }
+
+    bool isHotPartition(size_t index) const {
+        return index + kHotPartitions >= partitions_.partitions().size();
+    }
+
+    void loadPartition(size_t index) {
+        PartitionInfo& info = partitions_.partitions()[index];
+        info.last_used = ++partition_clock_;
+        if (info.resident) return;
+
+        ifstream file(partitions_.filePath(index));
+        if (!file.is_open()) {
+            cerr << "Warning: Could not open partition " << partitions_.filePath(index) << endl;
+            return;
+        }
+        vector<APIData> records;
+        records.reserve(info.rows);
+        size_t bytes = 0;
+        string line;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            APIData record;
+            parseAPIDataLine(line, record);
+            bytes += sizeof(APIData) + line.size();
+            records.push_back(move(record));
+        }
+        for (const auto& record : records) updateLatest(record);
+        // Sketches outlive eviction, so each partition is summarized once.
+        if (!info.sketched) {
+            for (const auto& record : records) {
+                quantiles_.add(record.district, record.state, dateToDayNumber(record.date), static_cast<float>(record.apiReading));
+            }
+            info.sketched = true;
+        }
+        // Segments stay in month order, ahead of readings ingested at runtime,
+        // so scans see the same order whatever was loaded first.
+        size_t segment = 0, offset = 0;
+        while (segment < resident_segments_.size() && resident_segments_[segment] < index) {
+            offset += partitions_.partitions()[resident_segments_[segment++]].rows;
+        }
+        api_data_.insert(api_data_.begin() + offset, make_move_iterator(records.begin()),
+            make_move_iterator(records.end()));
+        info.rows = records.size();
+        info.bytes = bytes;
+        info.resident = true;
+        resident_segments_.insert(resident_segments_.begin() + segment, index);
+        table_dirty_ = true;
+        cursor_ = PageCursor();   // row ids shift
+        clearResponseCache();     // cached answers saw different data
+    }
+
+    void evictPartition(size_t index) {
+        PartitionInfo& info = partitions_.partitions()[index];
+        if (!info.resident) return;
+
+        size_t offset = 0;
+        for (size_t s = 0; s < resident_segments_.size(); s++) {
+            if (resident_segments_[s] == index) {
+                api_data_.erase(api_data_.begin() + offset, api_data_.begin() + offset + info.rows);
+                resident_segments_.erase(resident_segments_.begin() + s);
+                break;
+            }
+            offset += partitions_.partitions()[resident_segments_[s]].rows;
+        }
+        info.resident = false;
+        info.bytes = 0;
+        table_dirty_ = true;
+        cursor_ = PageCursor();
+        clearResponseCache();
+    }
+
+    // Make sure every month a query reads is resident, so the answer does
+    // not depend on what earlier queries happened to load, and load nothing
+    // else. Rankings, statistics and the other whole-dataset intents read
+    // every month (history words with an area: that area's months); a date
+    // its day and the day before; otherwise month names their months, and
+    // an area on its own its two newest months, the window its history
+    // answer covers.
+    // Percentiles read the sketches, which outlive eviction, so only months
+    // never summarized are loaded. Keywords count as whole words only.
+    void preparePartitionsFor(const string& user_message) {
+        auto& parts = partitions_.partitions();
+        string lower_message = user_message;
+        transform(lower_message.begin(), lower_message.end(), lower_message.begin(), ::tolower);
+
+        double quantile;
+        if (parsePercentile(user_message, quantile)) {
+            for (size_t i = 0; i < parts.size(); i++) if (!parts[i].sketched) loadPartition(i);
+            return;
+        }
+
+        set<string> words;
+        string word;
+        for (char c : lower_message + " ") {
+            if (isalnum(static_cast<unsigned char>(c))) word += c;
+            else if (!word.empty()) { words.insert(word); word.clear(); }
+        }
+        static const vector<string> full_history = {
+            "rank", "ranking", "rankings", "ranked", "cleanest", "polluted", "dirtiest", "stat", "stats",
+            "statistic", "statistics", "history", "historical", "trend", "trends", "compare", "comparison",
+            "chart", "charts", "graph", "plot"
+        };
+        static const set<string> full_history_intents = {
+            "rank_cleanest", "rank_polluted", "rank_all", "stats", "history", "trend", "compare", "chart",
+            "worst_days", "best_days", "list_areas"
+        };
+        bool everything = full_history_intents.count(intentOf(user_message)) > 0;
+        for (const auto& keyword : full_history) everything = everything || words.count(keyword) > 0;
+        bool day_words = words.count("day") || words.count("days") || words.count("date") || words.count("dates");
+        everything = everything || (day_words && (words.count("worst") || words.count("best") || words.count("top")));
+
+        string district, state;
+        vector<size_t> area_parts;
+        if (matchPartitionArea(user_message, district, state)) area_parts = partitionsWith(district, state);
+
+        if (everything) {
+            if (!area_parts.empty()) for (size_t i : area_parts) loadPartition(i);
+            else for (size_t i = 0; i < parts.size(); i++) loadPartition(i);
+            return;
+        }
+
+        set<size_t> needed;
+        string date = extractDateFromQuery(user_message);
+        int day = dateToDayNumber(date);
+        if (day > 0) {
+            for (size_t i : partitions_.overlapping(dayNumberToDate(day - 1), date)) needed.insert(i);
+        }
+
+        for (const auto& named : day > 0 ? vector<pair<int, int>>() : monthsNamedIn(lower_message)) {
+            char month[8];
+            snprintf(month, sizeof(month), "-%02d", named.second);
+            for (size_t i = 0; i < parts.size(); i++) {
+                const string& m = parts[i].month;
+                if (m.size() == 7 && m.compare(4, 3, month) == 0 &&
+                    (named.first == 0 || m.compare(0, 4, to_string(named.first)) == 0)) needed.insert(i);
+            }
+        }
+
+        if (needed.empty() && !area_parts.empty()) {
+            size_t window = min(area_parts.size(), kAreaMonths);
+            needed.insert(area_parts.end() - window, area_parts.end());
+        }
+        for (size_t i : needed) loadPartition(i);
+    }
+
+    // The first area the manifest lists that the message names. Older
+    // manifests have no states; their districts are matched alone.
+    bool matchPartitionArea(const string& user_message, string& district, string& state) {
+        string lower_message = user_message;
+        transform(lower_message.begin(), lower_message.end(), lower_message.begin(), ::tolower);
+        for (const auto& p : partitions_.partitions()) {
+            for (size_t d = 0; d < p.districts.size(); d++) {
+                string lower_district = p.districts[d];
+                transform(lower_district.begin(), lower_district.end(), lower_district.begin(), ::tolower);
+                bool match = p.states.empty() ? lower_message.find(lower_district) != string::npos
+                    : isAreaMatch(user_message, p.districts[d], p.states[d]);
+                if (match) {
+                    district = p.districts[d];
+                    state = p.states.empty() ? string() : p.states[d];
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Partitions (in month order) whose manifest lists the district; an
+    // empty state matches any.
+    vector<size_t> partitionsWith(const string& district, const string& state) const {
+        vector<size_t> out;
+        const auto& parts = partitions_.partitions();
+        for (size_t i = 0; i < parts.size(); i++) {
+            for (size_t d = 0; d < parts[i].districts.size(); d++) {
+                if (parts[i].districts[d] == district && (state.empty() || parts[i].states.empty() || parts[i].states[d] == state)) {
+                    out.push_back(i);
+                    break;
+                }
+            }
+        }
+        return out;
+    }
+
+    // First day an area's history answer covers: the start of its
+    // kAreaMonths newest months in a partition directory, else everything.
+    int areaHistoryStart(const string& district, const string& state) const {
+        if (!partitioned_) return INT_MIN;
+        vector<size_t> area_parts = partitionsWith(district, state);
+        if (area_parts.empty()) return INT_MIN;
+        size_t window = min(area_parts.size(), kAreaMonths);
+        return dateToDayNumber(partitions_.partitions()[area_parts[area_parts.size() - window]].first_date);
+    }
+
+    // Unload least recently used cold partitions until resident data fits
+    // the partition budget and tracked memory fits the overall budget. The
+    // newest months are never unloaded.
+    void enforcePartitionBudget() {
+        auto& parts = partitions_.partitions();
+        size_t resident = 0;
+        for (const auto& p : parts) resident += p.bytes;
+
+        bool evicted = false;
+        while (resident > partition_budget_bytes_ || MemoryLedger::total() > memory_budget_bytes_) {
+            long victim = -1;
+            for (size_t i = 0; i < parts.size(); i++) {
+                if (!parts[i].resident || isHotPartition(i)) continue;
+                if (victim < 0 || parts[i].last_used < parts[victim].last_used) victim = static_cast<long>(i);
+            }
+            if (victim < 0) break;
+            resident -= parts[victim].bytes;
+            evictPartition(victim);
+            partition_evictions_++;
+            evicted = true;
+
+            // Give the memory back so the ledger reflects the eviction.
+            api_data_.shrink_to_fit();
+            table_ = ColumnTable();
+            table_dirty_ = true;
+        }
+        if (evicted) columns();
+    }
+
+    // Date range for Parquet sources (--parquet-range), set before loading;
+    // shard workers inherit it.
+    static ParquetFilter& parquetRange() {
+        static ParquetFilter range;
+        return range;
+    }
+
+    // Load readings from a Parquet export. Only the district/state/api/status/date
+    // columns are read, and row groups whose date statistics fall outside
+    // parquetRange() are skipped before any page is decoded.
+    void loadParquetData(const string& filename) {
+        const ParquetFilter& filter = parquetRange();
+        ParquetReader reader;
+        if (!reader.open(filename)) {
+            cerr << "Warning: Could not read parquet file " << filename << ": " << reader.error() << endl;
+            return;
+        }
+
+        int district_col = reader.findColumn({ "district", "area" });
+        int state_col = reader.findColumn({ "state" });
+        int api_col = reader.findColumn({ "api", "api_reading", "apiReading", "reading" });
+        int status_col = reader.findColumn({ "status" });
+        int date_col = reader.findColumn({ "date", "day" });
+        if (district_col < 0 || state_col < 0 || api_col < 0 || date_col < 0) {
+            cerr << "Warning: " << filename << " is missing district/state/api/date columns" << endl;
+            return;
+        }
+        // Dates are strings or INT32 day counts (DATE); an INT64 timestamp is not a day.
+        int date_type = reader.schema()[date_col].type;
+        if (date_type != ParquetReader::BYTE_ARRAY && date_type != ParquetReader::INT32) {
+            cerr << "Warning: " << filename << ": the date column must be a string or an INT32 DATE" << endl;
+            return;
+        }
+
+        size_t loaded_before = loaded_rows_;
+        size_t skipped_groups = 0;
+        const auto& row_groups = reader.rowGroups();
+
+        for (size_t rg = 0; rg < row_groups.size(); rg++) {
+            if (!rowGroupMayMatch(reader, rg, date_col, filter)) {
+                skipped_groups++;
+                continue;
+            }
+
+            ParquetReader::ColumnValues districts, states, apis, statuses, dates;
+            if (!reader.readColumn(rg, district_col, districts) ||
+                !reader.readColumn(rg, state_col, states) ||
+                !reader.readColumn(rg, api_col, apis) ||
+                !reader.readColumn(rg, date_col, dates) ||
+                (status_col >= 0 && !reader.readColumn(rg, status_col, statuses))) {
+                cerr << "Warning: Stopped reading " << filename << ": " << reader.error() << endl;
+                break;
+            }
+
+            // Rows are indexed by what was decoded, not by the row group's
+            // header: a short chunk or a column of the wrong type stops the load.
+            size_t rows = static_cast<size_t>(max<int64_t>(0, row_groups[rg].num_rows));
+            if (districts.strs.size() < rows || states.strs.size() < rows || apis.valid.size() < rows ||
+                (dates.strs.size() < rows && dates.ints.size() < rows) ||
+                (status_col >= 0 && statuses.strs.size() < rows)) {
+                cerr << "Warning: Stopped reading " << filename << ": row group " << rg
+                    << " has fewer decoded values than rows, or a column of an unexpected type" << endl;
+                break;
+            }
+
+            if (!shards_ && !shard_count_) api_data_.reserve(api_data_.size() + rows);
+            for (size_t r = 0; r < rows; r++) {
+                APIData record;
+                record.date = dates.strs.size() >= rows ? dates.strs[r] : ParquetReader::formatDate(dates.ints[r]);
+                if (record.date.empty()) continue;
+                if (!filter.date_from.empty() && record.date < filter.date_from) continue;
+                if (!filter.date_to.empty() && record.date > filter.date_to) continue;
+                record.district = move(districts.strs[r]);
+                record.state = move(states.strs[r]);
+                if (!apis.dbls.empty()) record.apiReading = static_cast<int>(apis.dbls[r] + 0.5);
+                else if (!apis.ints.empty()) record.apiReading = static_cast<int>(apis.ints[r]);
+                else {
+                    try { record.apiReading = stoi(apis.strs[r]); }
+                    catch (...) { record.apiReading = 0; }
+                }
+                record.status = (status_col >= 0 && statuses.valid[r]) ? move(statuses.strs[r]) : getStatusFromAPI(record.apiReading);
+                addRecord(move(record));
+            }
+        }
+
+        cout << "Loaded " << loaded_rows_ - loaded_before << " air quality records from " << filename;
+        if (skipped_groups > 0) cout << " (skipped " << skipped_groups << " of " << row_groups.size() << " row groups)";
+        cout << ".\n";
+    }
+
+    // Row group pruning using the date column's min/max statistics.
+    static bool rowGroupMayMatch(const ParquetReader& reader, size_t rg, int date_col, const ParquetFilter& filter) {
+        if (filter.date_from.empty() && filter.date_to.empty()) return true;
+        const auto& column = reader.rowGroups()[rg].columns[date_col];
+        if (!column.stats.has_min_max) return true;
+        string min_date = column.stats.min_value, max_date = column.stats.max_value;
+        if (column.type == ParquetReader::INT32) {
+            if (min_date.size() != 4 || max_date.size() != 4) return true;
+            int32_t lo, hi;
+            memcpy(&lo, min_date.data(), 4);
+            memcpy(&hi, max_date.data(), 4);
+            min_date = ParquetReader::formatDate(lo);
+            max_date = ParquetReader::formatDate(hi);
+            if (min_date.empty() || max_date.empty()) return true;
+        }
+        if (!filter.date_from.empty() && max_date < filter.date_from) return false;
+        if (!filter.date_to.empty() && min_date > filter.date_to) return false;
+        return true;
     }
 
     void initializeKnowledgeBase() {
-        knowledge_base_["hello"] = "Hello! I am Malaysia Air Pollutant AI with 1-month historical data (Oct-Nov 2025).";
-        knowledge_base_["hi"] = "Hi! I have daily API data. Ask me about specific dates like 'today', '29 Nov', or 'How was KL yesterday?'";
-        knowledge_base_["air quality"] = "I have 1 month of daily API data. Which area or date are you interested in?";
-        knowledge_base_["api"] = "API stands for Air Pollutant Index. I can show historical trends since October 2025.";
-        knowledge_base_["today"] = "I can show you today's air quality data. Try: 'today api' or 'air quality today'";
-        knowledge_base_["29 nov"] = "I have data for November 29th. Try: '29 Nov API data' or 'How was KL on 29 Nov?'";
-        knowledge_base_["history"] = "I have data from October 29 to November 29, 2025. Ask about specific dates!";
-        knowledge_base_["trend"] = "I can show air quality trends. Try: 'trend in Kuala Lumpur' or 'compare months'";
-        knowledge_base_["pollution"] = "I monitor air pollution levels across Malaysia. Try asking about a specific state or district.";
-        knowledge_base_["malaysia"] = "I have air quality data for Malaysia. You can ask about states like Selangor, Penang, Johor, etc.";
-        knowledge_base_["quit"] = "Thank you for using Malaysia Air Pollutant AI. Breathe easy!";
-        knowledge_base_["exit"] = "Thank you for using Malaysia Air Pollutant AI. Stay safe!";
+        knowledge_index_.addDocument("hello", "Hello! I am Malaysia Air Pollutant AI with 1-month historical data (Oct-Nov 2025).");
+        knowledge_index_.addDocument("hi", "Hi! I have daily API data. Ask me about specific dates like 'today', '29 Nov', or 'How was KL yesterday?'");
+        knowledge_index_.addDocument("air quality", "I have 1 month of daily API data. Which area or date are you interested in?");
+        knowledge_index_.addDocument("api", "API stands for Air Pollutant Index. I can show historical trends since October 2025.");
+        knowledge_index_.addDocument("today", "I can show you today's air quality data. Try: 'today api' or 'air quality today'");
+        knowledge_index_.addDocument("29 nov", "I have data for November 29th. Try: '29 Nov API data' or 'How was KL on 29 Nov?'");
+        knowledge_index_.addDocument("history", "I have data from October 29 to November 29, 2025. Ask about specific dates!");
+        knowledge_index_.addDocument("trend", "I can show air quality trends. Try: 'trend in Kuala Lumpur' or 'compare months'");
+        knowledge_index_.addDocument("pollution", "I monitor air pollution levels across Malaysia. Try asking about a specific state or district.");
+        knowledge_index_.addDocument("malaysia", "I have air quality data for Malaysia. You can ask about states like Selangor, Penang, Johor, etc.");
+        knowledge_index_.addDocument("quit", "Thank you for using Malaysia Air Pollutant AI. Breathe easy!");
+        knowledge_index_.addDocument("exit", "Thank you for using Malaysia Air Pollutant AI. Stay safe!");
+        loadKnowledgeCorpus("air_quality_faq.tsv");
+        knowledge_index_.build();
 
         default_responses_ = {
             "I have daily air quality data. Try: 'today', '29 Nov', or 'How was Kuala Lumpur yesterday?'",
@@ -138,6 +985,23 @@ public:
         };
     }
 
+    // Optional FAQ corpus, one "question<TAB>answer" pair per line.
+    void loadKnowledgeCorpus(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) return;
+
+        string line;
+        size_t added = 0;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            size_t tab = line.find('\t');
+            if (tab == string::npos) continue;
+            knowledge_index_.addDocument(line.substr(0, tab), line.substr(tab + 1));
+            added++;
+        }
+        cout << "Loaded " << added << " FAQ answers.\n";
+    }
+
     string getStatusColor(const string& status) {
         if (status == "Good") return "\033[32m";
         if (status == "Moderate") return "\033[33m";
@@ -145,10 +1009,509 @@ public:
         return "\033[0m";
     }
 
+    static string normalizeCommand(const string& user_message) {
+        string command = user_message;
+        transform(command.begin(), command.end(), command.begin(), ::tolower);
+        command.erase(0, command.find_first_not_of(' '));
+        command.erase(command.find_last_not_of(' ') + 1);
+        return command;
+    }
+
+    // Cost class for admission control: the predicted intent (the keyword
+    // router may still answer instead), "command" for system commands,
+    // "keyword" when the classifier is unsure.
+    string intentOf(const string& user_message) {
+        string command = normalizeCommand(user_message);
+        if (command == "memory" || command.compare(0, 7, "memory ") == 0 || command == "metrics" ||
+            command.compare(0, 7, "ingest ") == 0 || command == "checkpoint" ||
+            command == "next page" || command == "next" || command == "more") return "command";
+        if (command.compare(0, 5, "json ") == 0) command.erase(0, 5);
+        double quantile;
+        if (parsePercentile(command, quantile)) return "percentile";
+        if (intent_model_.loaded()) {
+            IntentPrediction prediction = intent_model_.predict(command);
+            if (prediction.confidence >= kIntentConfidence) return intent_model_.labels()[prediction.label];
+        }
+        return "keyword";
+    }
+
+    bool cachedResponse(const string& user_message, string& response) {
+        string command = normalizeCommand(user_message);
+        auto cached = response_cache_index_.find(CachedText(command.data(), command.size()));
+        if (cached == response_cache_index_.end()) return false;
+        response_cache_.splice(response_cache_.begin(), response_cache_, cached->second);
+        response.assign(cached->second->second.begin(), cached->second->second.end());
+        return true;
+    }
+
+    // Shed under overload: the answer from before the latest readings if
+    // there is one, otherwise a fast busy reply.
+    string degradedResponse(const string& user_message, bool& stale) {
+        string command = normalizeCommand(user_message);
+        auto it = stale_answers_.find(CachedText(command.data(), command.size()));
+        stale = it != stale_answers_.end();
+        if (!stale) return "⏳ The service is busy right now. Please try again in a moment.";
+        return "⏳ Busy right now, so this answer is from before the latest readings:\n" +
+            string(it->second.begin(), it->second.end());
+    }
+
+    void setAdmission(const AdmissionControl* admission) { admission_ = admission; }
+
     string generateResponse(const string& user_message) {
+        string command = normalizeCommand(user_message);
+        if (command == "memory" || command.compare(0, 7, "memory ") == 0) return getMemoryReport(command);
+        if (command == "metrics") return getMetrics();
+        if (command.compare(0, 7, "ingest ") == 0) return ingestCommand(user_message.substr(user_message.find_first_not_of(' ') + 7));
+        if (command == "checkpoint") return checkpointCommand();
+        if (command.compare(0, 5, "json ") == 0) return generateJson(user_message.substr(user_message.find_first_not_of(' ') + 5));
+        if (command == "next page" || command == "next" || command == "more") return nextPage();
+        paged_response_ = false;
+        wrote_file_ = false;
+
+        CachedText key(command.data(), command.size());
+        auto cached = response_cache_index_.find(key);
+        if (cached != response_cache_index_.end()) {
+            response_cache_.splice(response_cache_.begin(), response_cache_, cached->second);
+            const CachedText& answer = cached->second->second;
+            return string(answer.begin(), answer.end());
+        }
+
+        if (partitioned_) preparePartitionsFor(user_message);
+        string response = routeMessage(user_message);
+        if (!paged_response_ && !wrote_file_ &&
+            find(default_responses_.begin(), default_responses_.end(), response) == default_responses_.end()) {
+            response_cache_.emplace_front(key, CachedText(response.data(), response.size()));
+            response_cache_index_[key] = response_cache_.begin();
+        }
+        enforceMemoryBudgets();
+        return response;
+    }
+
+    // Structured answer for integrations (n8n): the same handlers as the chat,
+    // with the typed answer serialized instead of rendered. Never cached or
+    // paged; handlers that only produce prose come back as {"intent":"text"}.
+    string generateJson(const string& user_message) {
+        PageCursor saved = move(cursor_);
+        cursor_ = PageCursor();
+        answered_ = false;
+        if (partitioned_) preparePartitionsFor(user_message);
+        string text = routeMessage(user_message);
+        enforceMemoryBudgets();
+        cursor_ = move(saved);
+
+        QueryAnswer prose;
+        if (!answered_) {
+            prose.intent = "text";
+            prose.text = stripAnsi(text);
+        }
+        JsonWriter json;
+        writeAnswerJson(answered_ ? answer_ : prose, json);
+        return json.str();
+    }
+
+    // Shard worker side of ShardCluster: one request line in, response lines out.
+    string answerShardRequest(const string& request) {
+        vector<string> f = ShardCluster::split(request, '\t');
+        stringstream out;
+        try {
+            if (f[0] == "PLAN") {
+                QueryPlan plan;
+                if (!ShardCluster::decodePlan(f, plan)) return "";
+                const ColumnTable& table = columns();
+                for (const auto& row : QueryEngine::execute(table, plan)) {
+                    ShardCluster::Partial p;
+                    p.row = row;
+                    if (plan.group_by == QueryPlan::GroupBy::AREA) {
+                        const auto& district = table.areaDistrict(row.group);
+                        const auto& state = table.stateName(table.areaState(row.group));
+                        p.key = string(district.begin(), district.end()) + "|" + string(state.begin(), state.end());
+                    }
+                    else if (plan.group_by == QueryPlan::GroupBy::STATE) {
+                        const auto& state = table.stateName(row.group);
+                        p.key = string(state.begin(), state.end());
+                    }
+                    else if (plan.group_by == QueryPlan::GroupBy::ROW) p.key = to_string(global_rows_[row.group]);
+                    else p.key = to_string(row.group);
+                    p.row.min_row = global_rows_[row.min_row];
+                    p.row.max_row = global_rows_[row.max_row];
+                    p.row.latest_row = global_rows_[row.latest_row];
+                    p.latest_day = table.day()[row.latest_row];
+                    p.latest_api = table.api()[row.latest_row];
+                    out << ShardCluster::encodePartial(p) << "\n";
+                }
+            }
+            else if (f[0] == "TILES" && f.size() == 5) {
+                for (const auto& tile : quantiles_.tiles(f[4], f[1] == "1", stoi(f[2]), stoi(f[3]))) {
+                    out << tile.first << "\t" << tile.second->encode() << "\n";
+                }
+            }
+            else if (f[0] == "ROWS" && f.size() == 5) {
+                for (size_t i : rowsOf(f[3], f[4], stoi(f[1]), stoi(f[2]))) {
+                    const APIData& data = api_data_[i];
+                    out << ShardCluster::encodeReading({ global_rows_[i], data.district, data.state, data.apiReading, data.status, data.date }) << "\n";
+                }
+            }
+            else if (f[0] == "AT" && f.size() == 2) {
+                for (const auto& field : ShardCluster::split(f[1], ',')) {
+                    size_t row = stoul(field);
+                    auto it = lower_bound(global_rows_.begin(), global_rows_.end(), row);
+                    if (it == global_rows_.end() || *it != row) continue;
+                    const APIData& data = api_data_[it - global_rows_.begin()];
+                    out << ShardCluster::encodeReading({ row, data.district, data.state, data.apiReading, data.status, data.date }) << "\n";
+                }
+            }
+            else if (f[0] == "INFO") {
+                for (const auto& area : quantiles_.areaKeys()) out << "area\t" << area << "\n";
+                for (const auto& state : quantiles_.stateKeys()) out << "state\t" << state << "\n";
+                if (!quantiles_.empty()) out << "days\t" << quantiles_.firstDay() << "\t" << quantiles_.lastDay() << "\n";
+            }
+            else if (f[0] == "INGEST" && f.size() > 1 && (f.size() - 1) % 6 == 0) {
+                for (size_t i = 1; i < f.size(); i += 6) {
+                    APIData record{ f[i], f[i + 1], stoi(f[i + 2]), f[i + 3], f[i + 4] };
+                    global_rows_.push_back(stoul(f[i + 5]));
+                    api_data_.push_back(record);
+                    if (!table_dirty_ && table_.size() + 1 == api_data_.size()) appendColumns(record);
+                    quantiles_.add(record.district, record.state, dateToDayNumber(record.date), static_cast<float>(record.apiReading));
+                }
+            }
+        }
+        catch (...) {
+            cerr << "Warning: Bad shard request: " << request << endl;
+        }
+        return out.str();
+    }
+
+    // Keeps the typed answer for generateJson and renders it as chat text.
+    string present(QueryAnswer answer) {
+        answer_ = move(answer);
+        answered_ = true;
+        return renderText(answer_);
+    }
+
+    string renderText(const QueryAnswer& answer) {
+        const string& intent = answer.intent;
+        if (intent == "rank_cleanest" || intent == "rank_polluted") return renderRanking(answer);
+        if (intent == "rank_all") return renderCompleteRanking(answer);
+        if (intent == "compare") return renderComparison(answer);
+        if (intent == "latest_worst" || intent == "latest_best" || intent == "list_areas") return renderLatestReadings(answer);
+        if (intent == "worst_days" || intent == "best_days") return renderDays(answer);
+        if (intent == "date") return renderDate(answer);
+        if (intent == "area_date") return renderAreaOnDate(answer);
+        if (intent == "area_info") return renderAreaHistory(answer);
+        if (intent == "chart") return renderChart(answer);
+        if (intent == "forecast") return renderForecast(answer);
+        if (intent == "outlook") return renderOutlook(answer);
+        if (intent == "percentile") return renderPercentile(answer);
+        if (intent == "health") return renderHealthAdvisory(answer);
+        if (intent == "trend") return renderTrend(answer);
+        if (intent == "stats") return renderStatistics(answer);
+        return answer.text;
+    }
+
+    static string stripAnsi(const string& text) {
+        string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+                i = text.find('m', i);
+                if (i == string::npos) break;
+                continue;
+            }
+            out += text[i];
+        }
+        return out;
+    }
+
+    // Districts and dates for the load generator's query templates.
+    void loadVocabulary(vector<string>& areas, vector<string>& dates) const {
+        set<string> area_set, date_set;
+        for (const auto& data : api_data_) {
+            area_set.insert(data.district);
+            date_set.insert(data.date);
+        }
+        for (const auto& area : area_order_) area_set.insert(area.first);
+        if (shards_ && !shards_->empty()) {
+            for (int day = shards_->firstDay(); day <= shards_->lastDay(); day++) date_set.insert(dayNumberToDate(day));
+        }
+        areas.assign(area_set.begin(), area_set.end());
+        dates.assign(date_set.begin(), date_set.end());
+    }
+
+    // Server mode: the first page and then every remaining page of a paged
+    // answer are handed to `emit` as they are rendered.
+    void streamResponse(const string& user_message, const function<void(const string&)>& emit) {
+        streaming_ = true;
+        emit(generateResponse(user_message));
+        while (cursor_.active()) emit(nextPage());
+        streaming_ = false;
+    }
+
+    string startPaged(PageCursor cursor) {
+        cursor_ = move(cursor);
+        paged_response_ = true;
+        string header = cursor_.header;
+        return header + nextPage();
+    }
+
+    string nextPage() {
+        if (!cursor_.active()) return "No more pages. Ask a new question!";
+
+        stringstream ss;
+        size_t end = min(cursor_.total, cursor_.next + kPageSize);
+        for (size_t i = cursor_.next; i < end; i++) ss << cursor_.row(i);
+        cursor_.next = end;
+
+        if (cursor_.active()) {
+            if (!streaming_) {
+                ss << "\n(Showing " << end << " of " << cursor_.total << ". Say 'next page' for more.)";
+            }
+        }
+        else {
+            ss << cursor_.footer;
+            cursor_ = PageCursor();
+        }
+        return ss.str();
+    }
+
+    // Cache budget first (drop least recently used answers), then the overall
+    // budget: drop every cached answer, then unload cold partitions.
+    void enforceMemoryBudgets() {
+        while (!response_cache_.empty() && MemoryLedger::current(MemSubsystem::CACHES) > cache_budget_bytes_) {
+            response_cache_index_.erase(response_cache_.back().first);
+            response_cache_.pop_back();
+            cache_evictions_++;
+        }
+        if (MemoryLedger::total() > memory_budget_bytes_ && (!response_cache_.empty() || !stale_answers_.empty())) {
+            cache_evictions_ += response_cache_.size() + stale_answers_.size();
+            clearResponseCache();
+            stale_answers_.clear();
+        }
+        if (partitioned_) enforcePartitionBudget();
+        if (MemoryLedger::total() > memory_budget_bytes_) {
+            cerr << "Warning: Tracked memory " << MemoryLedger::total() << " bytes exceeds the "
+                << memory_budget_bytes_ << " byte budget" << endl;
+        }
+    }
+
+    void clearResponseCache() {
+        response_cache_index_.clear();
+        response_cache_.clear();
+    }
+
+    // New readings: cached answers move to the stale set (most recent first).
+    void invalidateResponseCache() {
+        if (response_cache_.empty()) return;
+        if (stale_answers_.size() + response_cache_.size() > kStaleAnswers) stale_answers_.clear();
+        for (const auto& entry : response_cache_) {
+            if (stale_answers_.size() >= kStaleAnswers) break;
+            stale_answers_[entry.first] = entry.second;
+        }
+        clearResponseCache();
+    }
+
+    static string formatBytes(size_t bytes) {
+        stringstream ss;
+        ss << fixed << setprecision(1);
+        if (bytes >= (1u << 20)) ss << bytes / 1048576.0 << " MB";
+        else if (bytes >= 1024) ss << bytes / 1024.0 << " KB";
+        else ss << bytes << " B";
+        return ss.str();
+    }
+
+    // "memory", "memory budget <MB>", "memory cache <MB>", "memory partitions <MB>"
+    string getMemoryReport(const string& command) {
+        stringstream args(command);
+        string word, which;
+        double mb = -1;
+        args >> word >> which >> mb;
+        if (!which.empty()) {
+            if ((which != "budget" && which != "cache" && which != "partitions") || mb <= 0) {
+                return "Usage: 'memory', 'memory budget <MB>', 'memory cache <MB>' or 'memory partitions <MB>'";
+            }
+            size_t bytes = static_cast<size_t>(mb * 1048576);
+            if (which == "budget") memory_budget_bytes_ = bytes;
+            else if (which == "cache") cache_budget_bytes_ = bytes;
+            else partition_budget_bytes_ = bytes;
+            enforceMemoryBudgets();
+        }
+
+        stringstream ss;
+        ss << "🧠 Memory usage by subsystem:\n";
+        for (size_t i = 0; i < MemoryLedger::kSubsystems; i++) {
+            MemSubsystem sub = static_cast<MemSubsystem>(i);
+            ss << "• " << MemoryLedger::name(sub) << ": " << formatBytes(MemoryLedger::current(sub))
+                << " (peak " << formatBytes(MemoryLedger::peak(sub)) << ")\n";
+        }
+        ss << "• Total: " << formatBytes(MemoryLedger::total()) << " of " << formatBytes(memory_budget_bytes_) << " budget\n";
+        ss << "• Cached answers: " << response_cache_.size() << " (budget " << formatBytes(cache_budget_bytes_) << ")\n";
+        if (partitioned_) {
+            size_t resident = 0;
+            for (const auto& p : partitions_.partitions()) resident += p.bytes;
+            ss << "• Resident partitions: " << resident_segments_.size() << " of " << partitions_.partitions().size()
+                << ", " << formatBytes(resident) << " (budget " << formatBytes(partition_budget_bytes_) << ")\n";
+        }
+        ss << "• Evictions: " << cache_evictions_ << " cached answers, " << partition_evictions_ << " partitions";
+        return ss.str();
+    }
+
+    // A reading to ingest: five fields, a whole-number API and a real
+    // YYYY-MM-DD date. False (and nothing logged) otherwise.
+    static bool parseIngestLine(string line, APIData& record) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (count(line.begin(), line.end(), ',') != 4) return false;
+        parseAPIDataLine(line, record);
+        string api = line.substr(record.district.size() + record.state.size() + 2);
+        api.erase(api.find(','));
+        if (record.district.empty() || record.state.empty() || record.status.empty() || api.empty() || api.size() > 6 ||
+            !all_of(api.begin(), api.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) return false;
+        const string& date = record.date;
+        for (size_t i = 0; i < date.size(); i++) {
+            if (i == 4 || i == 7 ? date[i] != '-' : !isdigit(static_cast<unsigned char>(date[i]))) return false;
+        }
+        return date.size() == 10 && dayNumberToDate(dateToDayNumber(date)) == date;
+    }
+
+    // "ingest Klang,Selangor,87,Moderate,2025-12-01": acknowledged once the
+    // reading is on disk.
+    string ingestCommand(const string& line) {
+        APIData record;
+        if (!parseIngestLine(line, record)) return "Please use: ingest district,state,api,status,YYYY-MM-DD";
+        waitDurable(ingestReading(record));
+
+        stringstream ss;
+        ss << "📥 Recorded " << record.district << ", " << record.state << " on " << record.date << ": API "
+            << getStatusColor(record.status) << record.apiReading << " (" << record.status << ")\033[0m";
+        if (!log_ || log_->failed()) ss << "\n⚠️ The reading could not be logged and will not survive a restart.";
+        return ss.str();
+    }
+
+    string checkpointCommand() {
+        if (!log_ || log_->entries() == 0) return "Nothing to checkpoint: no readings logged since the last checkpoint.";
+        if (snapshot_file_.empty()) return "Checkpoints need a text data file; readings stay in " + log_path_ + ".";
+        size_t rows = unsaved_rows_;
+        if (!checkpoint()) return "⚠️ Checkpoint failed; readings remain in " + log_path_ + ".";
+        return "💾 Checkpointed " + to_string(rows) + " readings into " + snapshot_file_ + ".";
+    }
+
+    // Plain-text metrics dump, one "name{labels} value" per line.
+    string getMetrics() {
+        stringstream ss;
+        for (size_t i = 0; i < MemoryLedger::kSubsystems; i++) {
+            MemSubsystem sub = static_cast<MemSubsystem>(i);
+            ss << "\nchatbox_memory_bytes{subsystem=\"" << MemoryLedger::name(sub) << "\"} " << MemoryLedger::current(sub);
+            ss << "\nchatbox_memory_peak_bytes{subsystem=\"" << MemoryLedger::name(sub) << "\"} " << MemoryLedger::peak(sub);
+        }
+        ss << "\nchatbox_memory_budget_bytes " << memory_budget_bytes_;
+        ss << "\nchatbox_cache_budget_bytes " << cache_budget_bytes_;
+        ss << "\nchatbox_response_cache_entries " << response_cache_.size();
+        ss << "\nchatbox_budget_evictions_total{kind=\"cache\"} " << cache_evictions_;
+        ss << "\nchatbox_budget_evictions_total{kind=\"partition\"} " << partition_evictions_;
+        ss << "\nchatbox_records " << recordCount();
+        if (partitioned_) ss << "\nchatbox_partitions_resident " << resident_segments_.size();
+        if (log_) {
+            ss << "\nchatbox_log_entries " << log_->entries();
+            ss << "\nchatbox_log_bytes " << log_->bytes();
+            ss << "\nchatbox_log_group_commits_total " << log_->commits();
+        }
+        ss << "\nchatbox_checkpoint_seq " << checkpoint_seq_;
+        ss << "\nchatbox_stale_answers " << stale_answers_.size();
+        if (admission_) ss << admission_->metrics();
+        return ss.str();
+    }
+
+    string routeMessage(const string& user_message) {
+        // Percentiles are phrased too much like rankings and area questions
+        // for the classifier, so they are recognized explicitly.
+        double quantile;
+        if (parsePercentile(user_message, quantile)) return getPercentile(user_message, quantile);
+
+        IntentPrediction prediction;
+        if (intent_model_.loaded()) prediction = intent_model_.predict(user_message);
+        string intent = prediction.confidence >= kIntentConfidence ? intent_model_.labels()[prediction.label] : "";
+
+        // Near-certain predictions overrule incidental keywords ("run", "all");
+        // otherwise the classifier only covers messages no keyword rule takes.
+        string response;
+        if (prediction.confidence >= kIntentOverride) response = routeIntent(intent, user_message);
+        if (response.empty()) response = routeByKeywords(user_message);
+        if (response.empty() && !intent.empty()) response = routeIntent(intent, user_message);
+        if (!response.empty()) return response;
+
+        // Check knowledge base (BM25 over the FAQ corpus)
+        long best_answer = knowledge_index_.search(user_message);
+        if (best_answer >= 0) {
+            const auto& answer = knowledge_index_.document(best_answer).answer;
+            return string(answer.begin(), answer.end());
+        }
+
+        return getRandomResponse();
+    }
+
+    // Handler for a classified intent; empty when the intent needs details
+    // (an area or a date) that the message does not contain.
+    string routeIntent(const string& intent, const string& user_message) {
+        if (intent == "chart") return getChart(user_message);
+        if (intent == "forecast") return getForecast(user_message);
+        if (intent == "alerts") return getActiveAlerts();
+        if (intent == "rank_cleanest") return getCleanestAreasRanking();
+        if (intent == "rank_polluted") return getMostPollutedAreasRanking();
+        if (intent == "rank_all") return getCompleteRanking();
+        if (intent == "health") {
+            if (detectLocationInQuery(user_message).empty()) return "";
+            return getHealthAdvisoryForMessage(user_message);
+        }
+        if (intent == "trend") return analyzeTrends();
+        if (intent == "history") return getHistoricalSummary();
+        if (intent == "compare") return compareAreasOrTime(user_message);
+        if (intent == "worst_days") return getWorstDays();
+        if (intent == "best_days") return getBestDays();
+        if (intent == "latest_worst") return getWorstAreas();
+        if (intent == "latest_best") return getBestAreas();
+        if (intent == "list_areas") return getAllAreas();
+        if (intent == "stats") return getStatistics();
+        if (intent == "month") {
+            string lower_msg = user_message;
+            transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+            if (lower_msg.find("october") == string::npos && lower_msg.find("november") == string::npos) return "";
+            return analyzeByMonth(user_message);
+        }
+        if (intent == "date_query") {
+            string date = extractDateFromQuery(user_message);
+            if (date.empty()) return "";
+            string district, state;
+            if (findArea(user_message, district, state)) return getDataForAreaAndDate(district, date);
+            return getDataForDate(date);
+        }
+        if (intent == "area_info") {
+            string district, state;
+            if (findArea(user_message, district, state)) return getAreaInfoWithHistory(district, state, user_message);
+        }
+        return "";
+    }
+
+    // Keyword router: fixed-priority substring checks; empty when none match.
+    string routeByKeywords(const string& user_message) {
         string lower_message = user_message;
         transform(lower_message.begin(), lower_message.end(), lower_message.begin(), ::tolower);
 
+        // Chart requests for an area (or the national average)
+        if (lower_message.find("chart") != string::npos || lower_message.find("graph") != string::npos ||
+            lower_message.find("plot") != string::npos) {
+            return getChart(user_message);
+        }
+
+        // Active haze / spike alerts maintained at ingest
+        if (lower_message.find("alert") != string::npos || lower_message.find("spike") != string::npos ||
+            lower_message.find("anomal") != string::npos || lower_message.find("episode") != string::npos) {
+            return getActiveAlerts();
+        }
+
+        // Forecasts from the locally fitted models
+        if (lower_message.find("tomorrow") != string::npos || lower_message.find("forecast") != string::npos ||
+            lower_message.find("predict") != string::npos || lower_message.find("next week") != string::npos) {
+            return getForecast(user_message);
+        }
+
         // First, check for ranking queries
         string ranking_response = getRanking(user_message);
         if (!ranking_response.empty()) {
@@ -165,11 +1528,8 @@ public:
         string extracted_date = extractDateFromQuery(user_message);
         if (!extracted_date.empty()) {
             // Check if user is asking about a specific area with date using enhanced matching
-            for (const auto& data : api_data_) {
-                if (isAreaMatch(user_message, data.district, data.state)) {
-                    return getDataForAreaAndDate(data.district, extracted_date);
-                }
-            }
+            string district, state;
+            if (findArea(user_message, district, state)) return getDataForAreaAndDate(district, extracted_date);
 
             // If no specific area, return all data for that date
             return getDataForDate(extracted_date);
@@ -179,18 +1539,15 @@ public:
         if (lower_message.find("today") != string::npos) {
             if (lower_message.find("api") != string::npos || lower_message.find("air quality") != string::npos) {
                 // Check if specific area mentioned with "today"
-                for (const auto& data : api_data_) {
-                    if (isAreaMatch(user_message, data.district, data.state)) {
-                        return getDataForAreaAndDate(data.district, "2025-11-29");
-                    }
-                }
+                string district, state;
+                if (findArea(user_message, district, state)) return getDataForAreaAndDate(district, "2025-11-29");
                 return getDataForDate("2025-11-29");
             }
         }
 
         // Check for historical/temporal queries
         if (lower_message.find("trend") != string::npos) {
-            return analyzeTrends(user_message);
+            return analyzeTrends();
         }
         if (lower_message.find("history") != string::npos || lower_message.find("historical") != string::npos) {
             return getHistoricalSummary();
@@ -223,20 +1580,10 @@ public:
         }
 
         // Check for state/district queries with date context - USING ENHANCED MATCHING
-        for (const auto& data : api_data_) {
-            if (isAreaMatch(user_message, data.district, data.state)) {
-                return getAreaInfoWithHistory(data.district, data.state, user_message);
-            }
-        }
-
-        // Check knowledge base
-        for (const auto& pair : knowledge_base_) {
-            if (lower_message.find(pair.first) != string::npos) {
-                return pair.second;
-            }
-        }
+        string district, state;
+        if (findArea(user_message, district, state)) return getAreaInfoWithHistory(district, state, user_message);
 
-        return getRandomResponse();
+        return "";
     }
 
 private:
@@ -267,106 +1614,165 @@ private:
     }
 
     string getCleanestAreasRanking() {
-        vector<pair<string, double>> area_avgs = calculateAreaAverages();
-
-        // Sort by average API (ascending - lower is better)
-        sort(area_avgs.begin(), area_avgs.end(),
-            [](const pair<string, double>& a, const pair<string, double>& b) {
-                return a.second < b.second;
-            });
+        return present(areaAverages("rank_cleanest"));
+    }
 
-        stringstream ss;
-        ss << "🏆 CLEANEST AREAS RANKING (Average API - Lower is Better):\n";
-        ss << "=============================================\n";
+    string getMostPollutedAreasRanking() {
+        return present(areaAverages("rank_polluted"));
+    }
 
-        for (int i = 0; i < min(10, (int)area_avgs.size()); i++) {
-            string medal = "";
-            if (i == 0) medal = "🥇 ";
-            else if (i == 1) medal = "🥈 ";
-            else if (i == 2) medal = "🥉 ";
-            else medal = to_string(i + 1) + ". ";
+    string getCompleteRanking() {
+        return present(areaAverages("rank_all"));
+    }
 
-            ss << medal << area_avgs[i].first << " - API: " << fixed << setprecision(1) << area_avgs[i].second << "\n";
+    // Average API per area, ordered and limited by the intent's plan.
+    QueryAnswer areaAverages(const string& intent) {
+        QueryAnswer answer;
+        answer.intent = intent;
+        for (const auto& row : runPlan(planForIntent(intent))) {
+            pair<string, string> area = areaOf(row.group);
+            answer.records.push_back({ area.first, area.second, "", row.value, getStatusFromAPI(row.value) });
         }
-
-        return ss.str();
+        return answer;
     }
 
-    string getMostPollutedAreasRanking() {
-        vector<pair<string, double>> area_avgs = calculateAreaAverages();
+    // District and state of an area group id from runPlan.
+    pair<string, string> areaOf(uint32_t group) {
+        if (shards_) return shards_->area(group);
+        const ColumnTable& table = columns();
+        const auto& district = table.areaDistrict(group);
+        const auto& state = table.stateName(table.areaState(group));
+        return { string(district.begin(), district.end()), string(state.begin(), state.end()) };
+    }
 
-        // Sort by average API (descending - higher is worse)
-        sort(area_avgs.begin(), area_avgs.end(),
-            [](const pair<string, double>& a, const pair<string, double>& b) {
-                return a.second > b.second;
-            });
+    string renderRanking(const QueryAnswer& answer) {
+        bool cleanest = answer.intent == "rank_cleanest";
+        static const char* medals[] = { "🥇 ", "🥈 ", "🥉 " };
+        static const char* warnings[] = { "🔴 ", "🟠 ", "🟡 " };
 
         stringstream ss;
-        ss << "⚠️ MOST POLLUTED AREAS RANKING (Average API - Higher is Worse):\n";
-        ss << "=================================================\n";
-
-        for (int i = 0; i < min(10, (int)area_avgs.size()); i++) {
-            string warning = "";
-            if (i == 0) warning = "🔴 ";
-            else if (i == 1) warning = "🟠 ";
-            else if (i == 2) warning = "🟡 ";
-            else warning = to_string(i + 1) + ". ";
+        if (cleanest) {
+            ss << "🏆 CLEANEST AREAS RANKING (Average API - Lower is Better):\n";
+            ss << "=============================================\n";
+        }
+        else {
+            ss << "⚠️ MOST POLLUTED AREAS RANKING (Average API - Higher is Worse):\n";
+            ss << "=================================================\n";
+        }
 
-            ss << warning << area_avgs[i].first << " - API: " << fixed << setprecision(1) << area_avgs[i].second << "\n";
+        for (size_t i = 0; i < answer.records.size(); i++) {
+            const AnswerRecord& r = answer.records[i];
+            string rank = i < 3 ? (cleanest ? medals[i] : warnings[i]) : to_string(i + 1) + ". ";
+            ss << rank << r.district << ", " << r.state << " - API: " << fixed << setprecision(1) << r.api << "\n";
         }
 
         return ss.str();
     }
 
-    string getCompleteRanking() {
-        vector<pair<string, double>> area_avgs = calculateAreaAverages();
-
-        // Sort by average API (ascending)
-        sort(area_avgs.begin(), area_avgs.end(),
-            [](const pair<string, double>& a, const pair<string, double>& b) {
-                return a.second < b.second;
-            });
-
-        stringstream ss;
-        ss << "📊 COMPLETE AIR QUALITY RANKING:\n";
-        ss << "===============================\n";
-
-        for (int i = 0; i < area_avgs.size(); i++) {
+    string renderCompleteRanking(const QueryAnswer& answer) {
+        PageCursor cursor;
+        cursor.header = "📊 COMPLETE AIR QUALITY RANKING:\n===============================\n";
+        cursor.total = answer.records.size();
+        cursor.row = [this, records = answer.records](size_t i) {
             string rank_indicator = to_string(i + 1) + ". ";
             if (i == 0) rank_indicator = "🥇 ";
             else if (i == 1) rank_indicator = "🥈 ";
             else if (i == 2) rank_indicator = "🥉 ";
-            else if (i < 10) rank_indicator = to_string(i + 1) + ". ";
 
-            string status = getStatusFromAPI(area_avgs[i].second);
-            string color = getStatusColor(status);
+            const AnswerRecord& r = records[i];
+            string color = getStatusColor(r.status);
             string reset = "\033[0m";
 
-            ss << rank_indicator << area_avgs[i].first << " - API: " << fixed << setprecision(1)
-                << area_avgs[i].second << " (" << color << status << reset << ")\n";
+            stringstream ss;
+            ss << rank_indicator << r.district << ", " << r.state << " - API: " << fixed << setprecision(1)
+                << r.api << " (" << color << r.status << reset << ")\n";
+            return ss.str();
+        };
+        return startPaged(move(cursor));
+    }
+
+    // Columnar mirror of api_data_, rebuilt after bulk loads or partition
+    // changes and appended to on ingest.
+    const ColumnTable& columns() {
+        if (table_dirty_ || table_.size() != api_data_.size()) {
+            table_ = ColumnTable();
+            table_.reserve(api_data_.size());
+            for (const auto& data : api_data_) appendColumns(data);
+            table_dirty_ = false;
         }
+        return table_;
+    }
 
-        return ss.str();
+    void appendColumns(const APIData& data) {
+        int month = 0;
+        if (data.date.size() >= 7) {
+            try { month = stoi(data.date.substr(0, 4)) * 12 + stoi(data.date.substr(5, 2)) - 1; }
+            catch (...) { month = 0; }
+        }
+        table_.append(data.district, data.state, data.apiReading, dateToDayNumber(data.date), month, data.status);
     }
 
-    vector<pair<string, double>> calculateAreaAverages() {
-        map<string, vector<int>> area_readings;
+    vector<ResultRow> runPlan(const QueryPlan& plan) {
+        if (shards_) return shards_->execute(plan);
+        return QueryEngine::execute(columns(), plan);
+    }
 
-        // Collect all readings for each area
-        for (const auto& data : api_data_) {
-            string key = data.district + ", " + data.state;
-            area_readings[key].push_back(data.apiReading);
+    // Readings of one area (every area when `district` is empty) on days
+    // [day_from, day_to], in load order.
+    vector<APIData> readingsOf(const string& district, const string& state, int day_from, int day_to) {
+        vector<APIData> out;
+        if (shards_) {
+            for (auto& r : shards_->readings(district, state, day_from, day_to)) {
+                out.push_back({ move(r.district), move(r.state), r.api, move(r.status), move(r.date) });
+            }
+            return out;
+        }
+        for (size_t i : rowsOf(district, state, day_from, day_to)) out.push_back(api_data_[i]);
+        return out;
+    }
+
+    vector<size_t> rowsOf(const string& district, const string& state, int day_from, int day_to) {
+        const ColumnTable& table = columns();
+        vector<size_t> rows;
+        for (size_t i = 0; i < api_data_.size(); i++) {
+            if (table.day()[i] < day_from || table.day()[i] > day_to) continue;
+            if (!district.empty() && (api_data_[i].district != district || api_data_[i].state != state)) continue;
+            rows.push_back(i);
         }
+        return rows;
+    }
 
-        vector<pair<string, double>> averages;
-        for (const auto& pair : area_readings) {
-            double sum = 0;
-            for (int reading : pair.second) sum += reading;
-            double avg = sum / pair.second.size();
-            averages.push_back({ pair.first, avg });
+    // Readings at rows a plan returned, in that order.
+    vector<APIData> readingsAt(const vector<size_t>& rows) {
+        vector<APIData> out;
+        if (shards_) {
+            for (auto& r : shards_->readingsAt(rows)) {
+                out.push_back({ move(r.district), move(r.state), r.api, move(r.status), move(r.date) });
+            }
+            return out;
         }
+        for (size_t row : rows) out.push_back(api_data_[row]);
+        return out;
+    }
 
-        return averages;
+    // Logical plan for the table-shaped intents; handlers only render rows.
+    QueryPlan planForIntent(const string& intent) {
+        QueryPlan plan;
+        if (intent == "rank_cleanest" || intent == "rank_polluted" || intent == "rank_all" || intent == "compare") {
+            plan.group_by = QueryPlan::GroupBy::AREA;
+            plan.measure = QueryPlan::Measure::AVG;
+            plan.order = intent == "rank_cleanest" || intent == "rank_all" ? QueryPlan::Order::ASC : QueryPlan::Order::DESC;
+            plan.limit = intent == "rank_all" ? 0 : intent == "compare" ? 5 : 10;
+        }
+        else if (intent == "worst_days" || intent == "best_days") {
+            plan.group_by = QueryPlan::GroupBy::ROW;
+            plan.order = intent == "worst_days" ? QueryPlan::Order::DESC : QueryPlan::Order::ASC;
+            plan.limit = 5;
+        }
+        else if (intent == "month") {
+            plan.group_by = QueryPlan::GroupBy::MONTH;
+        }
+        return plan;   // "stats": one group over everything
     }
 
     string getStatusFromAPI(double api) {
@@ -397,6 +1803,10 @@ private:
             return "";
         }
 
+        return getHealthAdvisoryForMessage(user_message);
+    }
+
+    string getHealthAdvisoryForMessage(const string& user_message) {
         // Check if user mentioned a specific location
         string detected_location = detectLocationInQuery(user_message);
 
@@ -427,58 +1837,144 @@ private:
             }
         }
 
-        return "";
+        return findPlaceInQuery(lower_msg);
     }
 
-    string getSpecificHealthAdvisory(const string& location) {
-        // Get today's data for the specified location
-        vector<APIData> today_location_data;
-
-        for (const auto& data : api_data_) {
-            if (data.date == "2025-11-29") {
-                string lower_district = data.district;
-                string lower_state = data.state;
-                string lower_location = location;
+    // Look up 1-3 word phrases of the message in the place table, longest
+    // first, so the cost depends on message length rather than place count.
+    string findPlaceInQuery(const string& lower_msg) {
+        if (place_lookup_.empty()) return "";
 
-                transform(lower_district.begin(), lower_district.end(), lower_district.begin(), ::tolower);
-                transform(lower_state.begin(), lower_state.end(), lower_state.begin(), ::tolower);
-                transform(lower_location.begin(), lower_location.end(), lower_location.begin(), ::tolower);
+        vector<string> words;
+        string word;
+        for (char c : lower_msg) {
+            if (isalnum(static_cast<unsigned char>(c))) word += c;
+            else if (!word.empty()) { words.push_back(word); word.clear(); }
+        }
+        if (!word.empty()) words.push_back(word);
 
-                if (lower_district.find(lower_location) != string::npos ||
-                    lower_state.find(lower_location) != string::npos ||
-                    (lower_location == "kl" && lower_district.find("kuala lumpur") != string::npos) ||
-                    (lower_location == "jb" && lower_district.find("johor bahru") != string::npos) ||
-                    (lower_location == "kk" && lower_district.find("kota kinabalu") != string::npos)) {
+        for (size_t len = 3; len >= 1; len--) {
+            for (size_t i = 0; i + len <= words.size(); i++) {
+                string phrase = words[i];
+                for (size_t j = 1; j < len; j++) phrase += " " + words[i + j];
+                if (place_lookup_.count(phrase)) return phrase;
+            }
+        }
+        return "";
+    }
 
-                    today_location_data.push_back(data);
-                }
+    // Advisory for a place without its own reading today: inverse-distance
+    // weighted API from the nearest stations that reported today.
+    string getNearestStationAdvisory(const string& location) {
+        auto place = place_lookup_.find(location);
+        if (place == place_lookup_.end() || station_index_.size() == 0) return "";
+        const GeoPoint& origin = places_[place->second];
+
+        struct Nearby {
+            const GeoPoint* station;
+            double distance_km;
+            int api;
+        };
+        // Only stations with a reading on the newest day, so the estimate
+        // never mixes days.
+        vector<Nearby> nearby;
+        string newest = latest_.newestDate();
+        for (const auto& n : station_index_.nearest(origin.lat, origin.lon, 8)) {
+            const GeoPoint& st = stations_[n.index];
+            LatestReading reading;
+            if (!latest_.find(st.name, reading) || reading.date != newest) continue;
+            nearby.push_back({ &st, n.distance_km, reading.api });
+            if (nearby.size() == 3) break;
+        }
+        if (nearby.empty()) return "";
+
+        double weight_sum = 0, weighted = 0;
+        for (const auto& n : nearby) {
+            if (n.distance_km < 0.5) {
+                weight_sum = 1;
+                weighted = n.api;
+                break;
             }
+            double w = 1.0 / (n.distance_km * n.distance_km);
+            weight_sum += w;
+            weighted += w * n.api;
         }
+        double estimate = weighted / weight_sum;
+        string status = getStatusFromAPI(estimate);
 
-        if (today_location_data.empty()) {
+        stringstream ss;
+        ss << "📍 Health Advisory for " << origin.name << ", " << origin.state << " (Today - " << displayDate(newest) << "):\n";
+        ss << "================================\n";
+        ss << "There is no monitoring station in " << origin.name << ", so here are the nearest ones:\n";
+        for (const auto& n : nearby) {
+            ss << "• " << n.station->name << ", " << n.station->state << " (" << fixed << setprecision(1)
+                << n.distance_km << " km) - API: " << n.api << "\n";
+        }
+        ss << "\n📊 Estimated API: " << setprecision(0) << estimate << " (" << getStatusColor(status) << status
+            << "\033[0m, distance-weighted)\n";
+        ss << "Advice: " << getHealthAdvice(status) << "\n";
+        return ss.str();
+    }
+
+    // Latest reading of every station matching the location, from the
+    // materialized view (no history scan). The answer's period is the
+    // newest day in the data; stations without a reading that day keep
+    // their own date and are marked when rendered.
+    string getSpecificHealthAdvisory(const string& location) {
+        string lower_location = location;
+        transform(lower_location.begin(), lower_location.end(), lower_location.begin(), ::tolower);
+        vector<LatestReading> readings = latest_.match(lower_location);
+
+        if (readings.empty()) {
+            string nearest = getNearestStationAdvisory(location);
+            if (!nearest.empty()) return nearest;
             return "I couldn't find specific air quality data for " + location + " today. "
                 "You can check the overall Malaysia air quality or try asking about a nearby major city.";
         }
 
+        QueryAnswer answer;
+        answer.intent = "health";
+        answer.subject = location;
+        answer.period = latest_.newestDate();
+        for (const auto& r : readings) {
+            answer.advisories.push_back({ r.district, r.state, r.date, static_cast<double>(r.api), r.status, r.level,
+                getHealthAdvice(r.status) });
+        }
+        return present(answer);
+    }
+
+    // "2025-11-29" -> "29 Nov 2025"
+    static string displayDate(const string& date) {
+        static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+        int y = 0, m = 0, d = 0;
+        if (sscanf(date.c_str(), "%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12) return date;
+        return to_string(d) + " " + months[m - 1] + " " + to_string(y);
+    }
+
+    string renderHealthAdvisory(const QueryAnswer& answer) {
         stringstream ss;
-        ss << "📍 Health Advisory for " << location << " (Today - 29 Nov 2025):\n";
+        ss << "📍 Health Advisory for " << answer.subject << " (Today - " << displayDate(answer.period) << "):\n";
         ss << "================================\n\n";
 
-        for (const auto& data : today_location_data) {
-            string color = getStatusColor(data.status);
+        for (const auto& advisory : answer.advisories) {
+            string color = getStatusColor(advisory.status);
             string reset = "\033[0m";
 
-            ss << "🏙️  " << data.district << ", " << data.state << "\n";
-            ss << "📊 API: " << data.apiReading << " (" << color << data.status << reset << ")\n\n";
+            ss << "🏙️  " << advisory.district << ", " << advisory.state << "\n";
+            ss << "📊 API: " << static_cast<int>(advisory.api) << " (" << color << advisory.status << reset << ")\n";
+            if (advisory.date != answer.period) {
+                ss << "🕒 No reading for " << displayDate(answer.period) << "; this one is from " << displayDate(advisory.date) << "\n";
+            }
+            ss << "\n";
 
             // Detailed health advice based on API level
-            if (data.apiReading <= 50) {
+            if (advisory.level == "good") {
                 ss << "✅ EXCELLENT CONDITIONS - GO OUTSIDE! 🌞\n";
                 ss << "• Perfect for all outdoor activities\n";
                 ss << "• Great day for exercise, sports, and recreation\n";
                 ss << "• Enjoy the fresh air safely\n";
             }
-            else if (data.apiReading <= 100) {
+            else if (advisory.level == "moderate") {
                 ss << "⚠️ MODERATE CONDITIONS - PROCEED WITH CAUTION\n";
                 ss << "• Generally acceptable for most people\n";
                 ss << "• Unusually sensitive individuals should reduce prolonged outdoor exertion\n";
@@ -507,7 +2003,28 @@ private:
         return ss.str();
     }
 
-    // Simple and reliable area detection method
+    // The first area, in load order, that the message names.
+    bool findArea(const string& user_message, string& district, string& state) {
+        if (shards_) {
+            for (const auto& area : area_order_) {
+                if (isAreaMatch(user_message, area.first, area.second)) {
+                    district = area.first;
+                    state = area.second;
+                    return true;
+                }
+            }
+            return false;
+        }
+        for (const auto& data : api_data_) {
+            if (isAreaMatch(user_message, data.district, data.state)) {
+                district = data.district;
+                state = data.state;
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool isAreaMatch(const string& user_message, const string& district, const string& state) {
         string lower_msg = user_message;
         transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
@@ -533,6 +2050,28 @@ private:
     }
 
     // Date handling methods
+
+    // Months named in a (lowercase) message as { year, month }, year 0 when
+    // none follows the name. "may" only counts with a year after it.
+    static vector<pair<int, int>> monthsNamedIn(const string& lower_msg) {
+        static const char* names[] = { "january", "february", "march", "april", "may", "june", "july", "august",
+            "september", "october", "november", "december" };
+        vector<pair<int, int>> out;
+        for (int m = 0; m < 12; m++) {
+            size_t at = lower_msg.find(names[m]);
+            if (at == string::npos) continue;
+            size_t pos = at + strlen(names[m]);
+            while (pos < lower_msg.size() && lower_msg[pos] == ' ') pos++;
+            int year = 0;
+            size_t digits = 0;
+            while (pos + digits < lower_msg.size() && isdigit(static_cast<unsigned char>(lower_msg[pos + digits]))) digits++;
+            if (digits == 4) year = stoi(lower_msg.substr(pos, 4));
+            if (m == 4 && year == 0) continue;
+            out.push_back({ year, m + 1 });
+        }
+        return out;
+    }
+
     string extractDateFromQuery(const string& user_message) {
         string lower_msg = user_message;
         transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
@@ -592,66 +2131,68 @@ private:
     }
 
     string getDataForDate(const string& date) {
-        vector<APIData> date_data;
-        for (const auto& data : api_data_) {
-            if (data.date == date) {
-                date_data.push_back(data);
-            }
-        }
-
-        if (date_data.empty()) {
+        QueryPlan plan;
+        plan.day_from = plan.day_to = dateToDayNumber(date);
+        vector<ResultRow> summary = runPlan(plan);
+        if (date.size() != 10 || summary.empty()) {
             return "No data available for " + date;
         }
+        const ResultRow& all = summary[0];
+
+        QueryAnswer answer;
+        answer.intent = "date";
+        answer.subject = date;
+        plan.group_by = QueryPlan::GroupBy::ROW;
+        vector<size_t> rows;
+        for (const auto& row : runPlan(plan)) rows.push_back(row.group);
+        for (const auto& data : readingsAt(rows)) answer.records.push_back(toRecord(data));
+        answer.aggregate("average", all.average());
+        answer.aggregate("max", all.max);
+        answer.aggregate("min", all.min);
+        answer.aggregate("count", all.count);
+        return present(answer);
+    }
 
-        stringstream ss;
-        ss << "Air Quality Data for " << date << ":\n";
-        ss << "================================\n";
-
-        // Group by state
-        map<string, vector<APIData>> state_data;
-        for (const auto& data : date_data) {
-            state_data[data.state].push_back(data);
-        }
-
-        for (const auto& state_pair : state_data) {
-            ss << "\n" << state_pair.first << ":\n";
-            for (const auto& data : state_pair.second) {
-                string color_code = getStatusColor(data.status);
-                string reset_code = "\033[0m";
-                ss << "  • " << data.district << " - API: " << data.apiReading
-                    << " (" << color_code << data.status << reset_code << ")\n";
-            }
-        }
-
-        // Add summary
-        double avg = 0;
-        int worst = 0, best = 1000;
-        string worst_area, best_area;
-
-        for (const auto& data : date_data) {
-            avg += data.apiReading;
-            if (data.apiReading > worst) {
-                worst = data.apiReading;
-                worst_area = data.district + ", " + data.state;
-            }
-            if (data.apiReading < best) {
-                best = data.apiReading;
-                best_area = data.district + ", " + data.state;
-            }
-        }
-        avg /= date_data.size();
-
-        ss << "\nSummary for " << date << ":\n";
-        ss << "• Average API: " << fixed << setprecision(1) << avg << "\n";
-        ss << "• Worst: " << worst_area << " (API: " << worst << ")\n";
-        ss << "• Best: " << best_area << " (API: " << best << ")\n";
-        ss << "• Areas monitored: " << date_data.size() << "\n";
+    // Readings in row order, listed a page at a time grouped by state.
+    string renderDate(const QueryAnswer& answer) {
+        const vector<AnswerRecord>& records = answer.records;
+        vector<size_t> order;
+        for (size_t i = 0; i < records.size(); i++) order.push_back(i);
+        stable_sort(order.begin(), order.end(),
+            [&records](size_t a, size_t b) { return records[a].state < records[b].state; });
+
+        PageCursor cursor;
+        cursor.header = "Air Quality Data for " + answer.subject + ":\n================================\n";
+        cursor.total = order.size();
+        cursor.row = [this, records, order](size_t i) {
+            const AnswerRecord& data = records[order[i]];
+            stringstream ss;
+            if (i == 0 || records[order[i - 1]].state != data.state) ss << "\n" << data.state << ":\n";
+            string color_code = getStatusColor(data.status);
+            string reset_code = "\033[0m";
+            ss << "  • " << data.district << " - API: " << static_cast<int>(data.api)
+                << " (" << color_code << data.status << reset_code << ")\n";
+            return ss.str();
+        };
 
-        return ss.str();
+        // Add summary (first reading holding the extreme, as the plan reports)
+        const AnswerRecord* worst = &records[0];
+        const AnswerRecord* best = &records[0];
+        for (const auto& r : records) if (r.api == answer.get("max")) { worst = &r; break; }
+        for (const auto& r : records) if (r.api == answer.get("min")) { best = &r; break; }
+        stringstream ss;
+        ss << "\nSummary for " << answer.subject << ":\n";
+        ss << "• Average API: " << fixed << setprecision(1) << answer.get("average") << "\n";
+        ss << "• Worst: " << worst->district << ", " << worst->state << " (API: " << static_cast<int>(worst->api) << ")\n";
+        ss << "• Best: " << best->district << ", " << best->state << " (API: " << static_cast<int>(best->api) << ")\n";
+        ss << "• Areas monitored: " << static_cast<size_t>(answer.get("count")) << "\n";
+        cursor.footer = ss.str();
+        return startPaged(move(cursor));
     }
 
     string getDataForAreaAndDate(const string& area, const string& date) {
-        for (const auto& data : api_data_) {
+        int day = dateToDayNumber(date);
+        for (const auto& data : readingsOf("", "", day, day)) {
             string lower_district = data.district;
             transform(lower_district.begin(), lower_district.end(), lower_district.begin(), ::tolower);
             string lower_state = data.state;
@@ -663,32 +2204,46 @@ private:
                 lower_state.find(lower_area) != string::npos) &&
                 data.date == date) {
 
-                stringstream ss;
-                ss << "Air Quality in " << data.district << ", " << data.state << " on " << date << ":\n";
-                ss << "• API Reading: " << data.apiReading << "\n";
-                ss << "• Status: " << data.status << "\n";
-                ss << "• Advice: " << getHealthAdvice(data.status) << "\n";
+                QueryAnswer answer;
+                answer.intent = "area_date";
+                answer.subject = data.district + ", " + data.state;
+                answer.period = date;
+                answer.records.push_back(toRecord(data));
 
                 // Add context - compare with previous day if available
                 string prev_date = getPreviousDate(date);
                 if (!prev_date.empty()) {
-                    for (const auto& prev_data : api_data_) {
-                        if (prev_data.district == data.district && prev_data.state == data.state &&
-                            prev_data.date == prev_date) {
-                            int change = data.apiReading - prev_data.apiReading;
-                            string trend = change > 0 ? "worsened" : (change < 0 ? "improved" : "stable");
-                            ss << "• Change from previous day: " << trend << " by " << abs(change) << " points\n";
+                    int prev_day = dateToDayNumber(prev_date);
+                    for (const auto& prev_data : readingsOf(data.district, data.state, prev_day, prev_day)) {
+                        if (prev_data.date == prev_date) {
+                            answer.aggregate("change", data.apiReading - prev_data.apiReading);
                             break;
                         }
                     }
                 }
 
-                return ss.str();
+                return present(answer);
             }
         }
         return "No data found for " + area + " on " + date;
     }
 
+    string renderAreaOnDate(const QueryAnswer& answer) {
+        const AnswerRecord& data = answer.records[0];
+        stringstream ss;
+        ss << "Air Quality in " << answer.subject << " on " << answer.period << ":\n";
+        ss << "• API Reading: " << static_cast<int>(data.api) << "\n";
+        ss << "• Status: " << data.status << "\n";
+        ss << "• Advice: " << getHealthAdvice(data.status) << "\n";
+
+        double change = answer.get("change");
+        if (!isnan(change)) {
+            string trend = change > 0 ? "worsened" : (change < 0 ? "improved" : "stable");
+            ss << "• Change from previous day: " << trend << " by " << static_cast<int>(fabs(change)) << " points\n";
+        }
+        return ss.str();
+    }
+
     string getPreviousDate(const string& date) {
         // Simple date decrement for our dataset
         if (date == "2025-11-29") return "2025-11-28";
@@ -725,198 +2280,513 @@ private:
         return "";
     }
 
-    // Health advice method
-    string getHealthAdvice(const string& status) {
-        if (status == "Good") return "Air quality is satisfactory. Enjoy outdoor activities!";
-        if (status == "Moderate") return "Air quality is acceptable. Sensitive people should reduce prolonged outdoor exertion.";
-        if (status == "Unhealthy") return "Everyone may experience health effects. Reduce outdoor activities.";
-        return "No specific advice available.";
+    // Health advice method
+    string getHealthAdvice(const string& status) {
+        if (status == "Good") return "Air quality is satisfactory. Enjoy outdoor activities!";
+        if (status == "Moderate") return "Air quality is acceptable. Sensitive people should reduce prolonged outdoor exertion.";
+        if (status == "Unhealthy") return "Everyone may experience health effects. Reduce outdoor activities.";
+        return "No specific advice available.";
+    }
+
+    // Existing methods
+    string getWorstAreas() {
+        if (latest_.empty()) return "No data available.";
+        return present(latestReadings("latest_worst", latest_.worst(5), latest_.newestDate()));
+    }
+
+    string getBestAreas() {
+        if (latest_.empty()) return "No data available.";
+        return present(latestReadings("latest_best", latest_.best(5), latest_.newestDate()));
+    }
+
+    string getWorstDays() {
+        if (recordCount() == 0) return "No data available.";
+        return present(readingsForIntent("worst_days"));
+    }
+
+    string getBestDays() {
+        if (recordCount() == 0) return "No data available.";
+        return present(readingsForIntent("best_days"));
+    }
+
+    string getAllAreas() {
+        if (latest_.empty()) return "No data available.";
+        return present(latestReadings("list_areas", latest_.all(), latest_.newestDate()));
+    }
+
+    // Worst and best hold only readings of `newest`; the full list marks
+    // stations whose latest reading is older.
+    static QueryAnswer latestReadings(const string& intent, const vector<LatestReading>& readings, const string& newest) {
+        QueryAnswer answer;
+        answer.intent = intent;
+        answer.period = newest;
+        for (const auto& r : readings) answer.records.push_back({ r.district, r.state, r.date, static_cast<double>(r.api), r.status });
+        return answer;
+    }
+
+    // Individual readings picked by the intent's plan (the top-k rows for
+    // the day rankings).
+    QueryAnswer readingsForIntent(const string& intent) {
+        QueryPlan plan = planForIntent(intent);
+        bool by_row = plan.group_by == QueryPlan::GroupBy::ROW;
+
+        QueryAnswer answer;
+        answer.intent = intent;
+        vector<size_t> rows;
+        for (const auto& row : runPlan(plan)) rows.push_back(by_row ? row.group : row.latest_row);
+        for (const auto& data : readingsAt(rows)) answer.records.push_back(toRecord(data));
+        return answer;
+    }
+
+    static AnswerRecord toRecord(const APIData& data) {
+        return { data.district, data.state, data.date, static_cast<double>(data.apiReading), data.status };
+    }
+
+    string renderLatestReadings(const QueryAnswer& answer) {
+        stringstream ss;
+        if (answer.intent == "latest_worst") ss << "Current worst air quality areas (" << answer.period << "):\n";
+        else if (answer.intent == "latest_best") ss << "Current best air quality areas (" << answer.period << "):\n";
+        else ss << "All monitored areas (latest readings):\n";
+        for (const auto& r : answer.records) {
+            ss << "• " << r.district << ", " << r.state
+                << " - API: " << static_cast<int>(r.api) << " (" << r.status << ") on " << r.date;
+            if (r.date != answer.period) ss << " (no reading for " << answer.period << ")";
+            ss << "\n";
+        }
+        return ss.str();
+    }
+
+    string renderDays(const QueryAnswer& answer) {
+        stringstream ss;
+        ss << (answer.intent == "worst_days" ? "Worst air quality days recorded:\n" : "Best air quality days recorded:\n");
+        for (const auto& r : answer.records) {
+            ss << "• " << r.date << " - " << r.district << ", " << r.state
+                << " - API: " << static_cast<int>(r.api) << " (" << r.status << ")\n";
+        }
+        return ss.str();
+    }
+
+    string getAreaInfoWithHistory(const string& district, const string& state, const string& user_message) {
+        vector<APIData> area_data = readingsOf(district, state, areaHistoryStart(district, state), INT_MAX);
+
+        if (area_data.empty()) return "Sorry, I couldn't find data for " + district + ", " + state;
+
+        // Newest first; on the same day the later-loaded reading (a
+        // correction) first, as in the latest view.
+        reverse(area_data.begin(), area_data.end());
+        stable_sort(area_data.begin(), area_data.end(),
+            [](const APIData& a, const APIData& b) { return a.date > b.date; });
+
+        QueryAnswer answer;
+        answer.intent = "area_info";
+        answer.subject = district + ", " + state;
+        for (const auto& data : area_data) answer.records.push_back(toRecord(data));
+        return present(answer);
     }
 
-    // Existing methods
-    string getWorstAreas() {
-        if (api_data_.empty()) return "No data available.";
+    // Records newest first.
+    string renderAreaHistory(const QueryAnswer& answer) {
+        const vector<AnswerRecord>& area_data = answer.records;
+        stringstream ss;
+        ss << "Air Quality History for " << answer.subject << ":\n";
 
-        // Get latest data for each district
-        map<string, APIData> latest_data;
-        for (const auto& data : api_data_) {
-            if (latest_data.find(data.district) == latest_data.end() ||
-                data.date > latest_data[data.district].date) {
-                latest_data[data.district] = data;
-            }
-        }
+        // Show latest reading
+        ss << "Latest (" << area_data[0].date << "): API " << static_cast<int>(area_data[0].api) << " (" << area_data[0].status << ")\n\n";
 
-        vector<APIData> sorted_data;
-        for (const auto& pair : latest_data) {
-            sorted_data.push_back(pair.second);
+        // Show trend
+        if (area_data.size() >= 2) {
+            int change = static_cast<int>(area_data[0].api - area_data[1].api);
+            string trend = change > 0 ? "worsened" : (change < 0 ? "improved" : "stable");
+            ss << "Trend: " << trend << " by " << abs(change) << " points from previous day\n\n";
         }
 
-        sort(sorted_data.begin(), sorted_data.end(),
-            [](const APIData& a, const APIData& b) { return a.apiReading > b.apiReading; });
+        // Show last 5 days
+        ss << "Last 5 days:\n";
+        for (int i = 0; i < min(5, (int)area_data.size()); i++) {
+            ss << "• " << area_data[i].date << " - API: " << static_cast<int>(area_data[i].api) << " (" << area_data[i].status << ")\n";
+        }
 
-        stringstream ss;
-        ss << "Current worst air quality areas:\n";
-        for (int i = 0; i < min(5, (int)sorted_data.size()); i++) {
-            ss << "• " << sorted_data[i].district << ", " << sorted_data[i].state
-                << " - API: " << sorted_data[i].apiReading << " (" << sorted_data[i].status << ") on " << sorted_data[i].date << "\n";
+        if (area_data.size() >= 3) {
+            vector<ChartPoint> series;
+            for (auto it = area_data.rbegin(); it != area_data.rend(); ++it) {
+                series.push_back({ static_cast<double>(dateToDayNumber(it->date)), it->api });
+            }
+            ss << "\nHistory (" << area_data.back().date << " to " << area_data[0].date << "): " << renderSparkline(series) << "\n";
         }
+
+        ss << "\nAdvice: " << getHealthAdvice(area_data[0].status);
         return ss.str();
     }
 
-    string getBestAreas() {
-        if (api_data_.empty()) return "No data available.";
+    string getChart(const string& user_message) {
+        if (recordCount() == 0) return "No data available.";
 
-        map<string, APIData> latest_data;
-        for (const auto& data : api_data_) {
-            if (latest_data.find(data.district) == latest_data.end() ||
-                data.date > latest_data[data.district].date) {
-                latest_data[data.district] = data;
+        string lower_msg = user_message;
+        transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+
+        string district, state;
+        map<string, pair<double, int>> by_date;
+        if (findArea(user_message, district, state)) {
+            for (const auto& data : readingsOf(district, state, INT_MIN, INT_MAX)) {
+                auto& acc = by_date[data.date];
+                acc.first += data.apiReading;
+                acc.second++;
             }
         }
-
-        vector<APIData> sorted_data;
-        for (const auto& pair : latest_data) {
-            sorted_data.push_back(pair.second);
+        else {
+            QueryPlan plan;
+            plan.group_by = QueryPlan::GroupBy::DAY;
+            for (const auto& row : runPlan(plan)) {
+                by_date[dayNumberToDate(static_cast<int>(row.group))] = { static_cast<double>(row.sum), static_cast<int>(row.count) };
+            }
         }
 
-        sort(sorted_data.begin(), sorted_data.end(),
-            [](const APIData& a, const APIData& b) { return a.apiReading < b.apiReading; });
-
-        stringstream ss;
-        ss << "Current best air quality areas:\n";
-        for (int i = 0; i < min(5, (int)sorted_data.size()); i++) {
-            ss << "• " << sorted_data[i].district << ", " << sorted_data[i].state
-                << " - API: " << sorted_data[i].apiReading << " (" << sorted_data[i].status << ") on " << sorted_data[i].date << "\n";
+        QueryAnswer answer;
+        answer.intent = "chart";
+        answer.subject = district.empty() ? string("Malaysia (daily average)") : district + ", " + state;
+        AnswerSeries daily;
+        daily.name = answer.subject;
+        for (const auto& pair : by_date) {
+            daily.points.push_back({ pair.first, pair.second.first / pair.second.second });
+        }
+        answer.series.push_back(daily);
+        string response = present(answer);
+
+        if (lower_msg.find("svg") != string::npos) {
+            wrote_file_ = true;   // asking again writes the file again
+            string filename = "chart_" + (district.empty() ? string("malaysia") : district) + ".svg";
+            replace(filename.begin(), filename.end(), ' ', '_');
+            ofstream out(filename);
+            if (out.is_open()) {
+                out << renderSvg(chartPoints(daily), "API - " + answer.subject, { 50, 100 });
+                response += "SVG chart saved to " + filename + "\n";
+            }
+            else {
+                response += "Could not write " + filename + "\n";
+            }
         }
-        return ss.str();
+        return response;
     }
 
-    string getWorstDays() {
-        if (api_data_.empty()) return "No data available.";
-
-        vector<APIData> sorted_data = api_data_;
-        sort(sorted_data.begin(), sorted_data.end(),
-            [](const APIData& a, const APIData& b) { return a.apiReading > b.apiReading; });
+    static vector<ChartPoint> chartPoints(const AnswerSeries& series) {
+        vector<ChartPoint> points;
+        points.reserve(series.points.size());
+        for (const auto& p : series.points) points.push_back({ static_cast<double>(dateToDayNumber(p.date)), p.value });
+        return points;
+    }
 
+    string renderChart(const QueryAnswer& answer) {
+        const AnswerSeries& daily = answer.series[0];
         stringstream ss;
-        ss << "Worst air quality days recorded:\n";
-        for (int i = 0; i < min(5, (int)sorted_data.size()); i++) {
-            ss << "• " << sorted_data[i].date << " - " << sorted_data[i].district << ", " << sorted_data[i].state
-                << " - API: " << sorted_data[i].apiReading << " (" << sorted_data[i].status << ")\n";
-        }
+        ss << "📈 API Chart for " << answer.subject << " (" << daily.points.front().date << " to " << daily.points.back().date << "):\n";
+        ss << renderBraillePlot(chartPoints(daily));
+        ss << "Points: " << daily.points.size() << " days\n";
         return ss.str();
     }
 
-    string getBestDays() {
-        if (api_data_.empty()) return "No data available.";
+    string getForecast(const string& user_message) {
+        const auto& models = forecaster_.models();
+        if (models.empty()) return "No data available for forecasting.";
 
-        vector<APIData> sorted_data = api_data_;
-        sort(sorted_data.begin(), sorted_data.end(),
-            [](const APIData& a, const APIData& b) { return a.apiReading < b.apiReading; });
+        string lower_msg = user_message;
+        transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+        int horizon = (lower_msg.find("week") != string::npos ||
+            (lower_msg.find("forecast") != string::npos && lower_msg.find("tomorrow") == string::npos)) ? 7 : 1;
 
-        stringstream ss;
-        ss << "Best air quality days recorded:\n";
-        for (int i = 0; i < min(5, (int)sorted_data.size()); i++) {
-            ss << "• " << sorted_data[i].date << " - " << sorted_data[i].district << ", " << sorted_data[i].state
-                << " - API: " << sorted_data[i].apiReading << " (" << sorted_data[i].status << ")\n";
+        vector<const DistrictForecast*> matches;
+        for (const auto& pair : models) {
+            if (isAreaMatch(user_message, pair.second.district, pair.second.state)) {
+                matches.push_back(&pair.second);
+            }
         }
-        return ss.str();
-    }
 
-    string getAllAreas() {
-        if (api_data_.empty()) return "No data available.";
+        QueryAnswer answer;
+        if (matches.empty()) {
+            vector<pair<double, const DistrictForecast*>> outlook;
+            for (const auto& pair : models) outlook.push_back({ pair.second.forecast(1), &pair.second });
+            sort(outlook.begin(), outlook.end(),
+                [](const pair<double, const DistrictForecast*>& a, const pair<double, const DistrictForecast*>& b) { return a.first > b.first; });
 
-        map<string, APIData> latest_data;
-        for (const auto& data : api_data_) {
-            if (latest_data.find(data.district) == latest_data.end() ||
-                data.date > latest_data[data.district].date) {
-                latest_data[data.district] = data;
+            answer.intent = "outlook";
+            answer.period = dayNumberToDate(outlook[0].second->latestDay() + 1);
+            for (int i = 0; i < min(5, (int)outlook.size()); i++) {
+                answer.records.push_back({ outlook[i].second->district, outlook[i].second->state,
+                    dayNumberToDate(outlook[i].second->latestDay() + 1), outlook[i].first, getStatusFromAPI(outlook[i].first) });
+            }
+            return present(answer);
+        }
+
+        answer.intent = "forecast";
+        for (const DistrictForecast* f : matches) {
+            AnswerSeries series;
+            series.name = f->district + ", " + f->state;
+            double spread = f->model.rmse();
+            for (int h = 1; h <= horizon; h++) {
+                series.points.push_back({ dayNumberToDate(f->latestDay() + h), f->forecast(h), spread * sqrt((double)h) });
             }
+            answer.series.push_back(series);
         }
+        return present(answer);
+    }
 
+    string renderOutlook(const QueryAnswer& answer) {
         stringstream ss;
-        ss << "All monitored areas (latest readings):\n";
-        for (const auto& pair : latest_data) {
-            ss << "• " << pair.second.district << ", " << pair.second.state
-                << " - API: " << pair.second.apiReading << " (" << pair.second.status << ") on " << pair.second.date << "\n";
+        ss << "🔮 Tomorrow's Outlook (" << answer.period << ") - highest expected API:\n";
+        for (const auto& r : answer.records) {
+            ss << "• " << r.district << ", " << r.state << " - API ~"
+                << fixed << setprecision(0) << r.api << " (" << r.status << ")\n";
         }
+        ss << "Ask 'forecast <area>' for a 7-day outlook.";
         return ss.str();
     }
 
-    string getAreaInfoWithHistory(const string& district, const string& state, const string& user_message) {
-        vector<APIData> area_data;
-        for (const auto& data : api_data_) {
-            if (data.district == district && data.state == state) {
-                area_data.push_back(data);
+    string renderForecast(const QueryAnswer& answer) {
+        stringstream ss;
+        for (const auto& series : answer.series) {
+            ss << "🔮 Forecast for " << series.name << ":\n";
+            for (size_t h = 0; h < series.points.size(); h++) {
+                const AnswerPoint& p = series.points[h];
+                string status = getStatusFromAPI(p.value);
+                string color = getStatusColor(status);
+                string reset = "\033[0m";
+                ss << "• " << (h == 0 ? "Tomorrow " : "") << p.date << " - API ~"
+                    << fixed << setprecision(0) << p.value << " (±" << p.error << ") ("
+                    << color << status << reset << ")\n";
             }
+            ss << "Advice: " << getHealthAdvice(getStatusFromAPI(series.points[0].value)) << "\n\n";
         }
+        ss << "Forecasts are estimated locally from past readings and may differ from official forecasts.";
+        return ss.str();
+    }
 
-        if (area_data.empty()) return "Sorry, I couldn't find data for " + district + ", " + state;
-
-        // Sort by date
-        sort(area_data.begin(), area_data.end(),
-            [](const APIData& a, const APIData& b) { return a.date > b.date; });
+    bool parsePercentile(const string& user_message, double& quantile) {
+        string lower_msg = user_message;
+        transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+        if (lower_msg.find("median") != string::npos) {
+            quantile = 0.5;
+            return true;
+        }
+        static const regex ordinal(R"((\d{1,2}(?:\.\d+)?)\s*(?:st|nd|rd|th)?\s*percentile)");
+        static const regex trailing(R"(percentile\s*(?:of\s*)?(\d{1,2}(?:\.\d+)?))");
+        static const regex short_form(R"(\bp(\d{1,2}(?:\.\d+)?)\b)");
+        smatch match;
+        if (regex_search(lower_msg, match, ordinal) || regex_search(lower_msg, match, trailing) ||
+            regex_search(lower_msg, match, short_form)) {
+            quantile = stod(match[1]) / 100.0;
+            return quantile > 0 && quantile < 1;
+        }
+        return false;
+    }
 
-        stringstream ss;
-        ss << "Air Quality History for " << district << ", " << state << ":\n";
+    // Percentile over an area, a state or the whole country, for the period
+    // named in the message, answered from the merged quantile sketches.
+    string getPercentile(const string& user_message, double quantile) {
+        if (shards_ ? shards_->empty() : quantiles_.empty()) return "No data available.";
+        const vector<string> area_keys = shards_ ? shards_->areaKeys() : quantiles_.areaKeys();
+        const vector<string> state_keys = shards_ ? shards_->stateKeys() : quantiles_.stateKeys();
+        string lower_msg = user_message;
+        transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
 
-        // Show latest reading
-        ss << "Latest (" << area_data[0].date << "): API " << area_data[0].apiReading << " (" << area_data[0].status << ")\n\n";
+        // Region: a district first, then a state, else all of Malaysia.
+        string key, label = "Malaysia";
+        bool is_state = true;
+        auto lower = [](string s) { transform(s.begin(), s.end(), s.begin(), ::tolower); return s; };
+        for (const auto& area : area_keys) {
+            size_t bar = area.find('|');
+            if (lower_msg.find(lower(area.substr(0, bar))) != string::npos) {
+                key = area;
+                label = area.substr(0, bar) + ", " + area.substr(bar + 1);
+                is_state = false;
+                break;
+            }
+        }
+        if (is_state) {
+            for (const auto& state : state_keys) {
+                if (lower_msg.find(lower(state)) != string::npos) {
+                    key = label = state;
+                    break;
+                }
+            }
+        }
+        if (key.empty()) {
+            for (const auto& area : area_keys) {
+                size_t bar = area.find('|');
+                if (isAreaMatch(user_message, area.substr(0, bar), area.substr(bar + 1))) {
+                    key = area;
+                    label = area.substr(0, bar) + ", " + area.substr(bar + 1);
+                    is_state = false;
+                    break;
+                }
+            }
+        }
 
-        // Show trend
-        if (area_data.size() >= 2) {
-            int change = area_data[0].apiReading - area_data[1].apiReading;
-            string trend = change > 0 ? "worsened" : (change < 0 ? "improved" : "stable");
-            ss << "Trend: " << trend << " by " << abs(change) << " points from previous day\n\n";
+        // Period: explicit month or week words, a date, or the full history.
+        // "Today" is the newest reading's day.
+        int day_from = shards_ ? shards_->firstDay() : quantiles_.firstDay();
+        int day_to = shards_ ? shards_->lastDay() : quantiles_.lastDay();
+        int today = day_to;
+        string period = "all data";
+        int this_month = QuantileStore::monthOf(today);
+        vector<pair<int, int>> named = monthsNamedIn(lower_msg);
+        if (lower_msg.find("this month") != string::npos) {
+            day_from = QuantileStore::monthStart(this_month);
+            day_to = today;
+            period = "this month";
+        }
+        else if (lower_msg.find("last month") != string::npos) {
+            day_from = QuantileStore::monthStart(this_month - 1);
+            day_to = QuantileStore::monthStart(this_month) - 1;
+            period = "last month";
+        }
+        else if (lower_msg.find("week") != string::npos) {
+            day_from = today - 6;
+            day_to = today;
+            period = "the past 7 days";
+        }
+        else if (!named.empty()) {
+            // Without a year, the most recent such month up to today.
+            static const char* names[] = { "January", "February", "March", "April", "May", "June", "July",
+                "August", "September", "October", "November", "December" };
+            int year = named[0].first, number = named[0].second;
+            if (year == 0) year = this_month / 12 - (number - 1 > this_month % 12 ? 1 : 0);
+            int month = year * 12 + number - 1;
+            day_from = QuantileStore::monthStart(month);
+            day_to = QuantileStore::monthStart(month + 1) - 1;
+            period = string(names[number - 1]) + " " + to_string(year);
+        }
+        else {
+            string date = extractDateFromQuery(user_message);
+            if (!date.empty()) {
+                day_from = day_to = dateToDayNumber(date);
+                period = date;
+            }
         }
 
-        // Show last 5 days
-        ss << "Last 5 days:\n";
-        for (int i = 0; i < min(5, (int)area_data.size()); i++) {
-            ss << "• " << area_data[i].date << " - API: " << area_data[i].apiReading << " (" << area_data[i].status << ")\n";
+        QuantileStore::Result result = shards_ ? shards_->quantiles(key, is_state, day_from, day_to)
+            : quantiles_.query(key, is_state, day_from, day_to);
+        if (result.sketch.count() == 0) {
+            return "No readings for " + label + " in " + period + ".";
         }
 
-        ss << "\nAdvice: " << getHealthAdvice(area_data[0].status);
+        QueryAnswer answer;
+        answer.intent = "percentile";
+        answer.subject = label;
+        answer.period = period;
+        answer.aggregate("quantile", quantile);
+        answer.aggregate("value", result.sketch.quantile(quantile));
+        answer.aggregate("readings", static_cast<double>(result.sketch.count()));
+        answer.aggregate("sketches_merged", static_cast<double>(result.sketches_merged));
+        answer.aggregate("rank_error", result.sketch.rankError());
+        return present(answer);
+    }
+
+    string renderPercentile(const QueryAnswer& answer) {
+        double quantile = answer.get("quantile");
+        double value = answer.get("value");
+        double rank_error = answer.get("rank_error");
+        stringstream ss;
+        string name = quantile == 0.5 ? "Median" : "P" + to_string(static_cast<int>(quantile * 100 + 0.5));
+        string status = getStatusFromAPI(value);
+        ss << "📐 " << name << " API for " << answer.subject << " (" << answer.period << "):\n";
+        ss << "• " << name << ": " << fixed << setprecision(0) << value << " (" << getStatusColor(status) << status << "\033[0m)\n";
+        ss << "• Readings: " << static_cast<uint64_t>(answer.get("readings"))
+            << " (" << static_cast<size_t>(answer.get("sketches_merged")) << " sketches merged)\n";
+        if (rank_error == 0) ss << "• Error: exact";
+        else ss << "• Error: within ±" << setprecision(1) << rank_error * 100 << "% rank (99% confidence)";
         return ss.str();
     }
 
-    string analyzeTrends(const string& user_message) {
-        string lower_msg = user_message;
-        transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+    string getActiveAlerts() {
+        const auto& alerts = detector_.activeAlerts();
+        if (alerts.empty()) {
+            return "✅ No active air quality alerts across " + to_string(detector_.seriesCount()) + " monitored areas.";
+        }
 
-        // Simple trend analysis - compare first and last week
-        vector<APIData> early_nov, late_nov;
+        vector<const AnomalyAlert*> sorted;
+        for (const auto& pair : alerts) sorted.push_back(&pair.second);
+        sort(sorted.begin(), sorted.end(), [](const AnomalyAlert* a, const AnomalyAlert* b) {
+            if (a->value != b->value) return a->value > b->value;
+            return a->district != b->district ? a->district < b->district : a->state < b->state;   // not hash order
+        });
 
-        for (const auto& data : api_data_) {
-            if (data.date.find("2025-11-01") != string::npos ||
-                data.date.find("2025-11-02") != string::npos ||
-                data.date.find("2025-11-03") != string::npos) {
-                early_nov.push_back(data);
+        static const char* bands[] = { "Good", "Moderate", "Unhealthy" };
+        stringstream ss;
+        ss << "🚨 ACTIVE AIR QUALITY ALERTS (" << sorted.size() << "):\n";
+        ss << "================================\n";
+        for (const AnomalyAlert* a : sorted) {
+            string status = bands[a->band_to];
+            ss << "• " << a->district << ", " << a->state << " - API " << fixed << setprecision(0) << a->value
+                << " (" << getStatusColor(status) << status << "\033[0m) on " << a->date << "\n";
+            if (a->kind == AnomalyAlert::BAND_CROSSING) {
+                ss << "  Worsened from " << bands[a->band_from];
+                if (a->since != a->date) ss << " on " << a->since;
+                ss << " (previous reading " << a->previous << ")\n";
             }
-            if (data.date.find("2025-11-27") != string::npos ||
-                data.date.find("2025-11-28") != string::npos ||
-                data.date.find("2025-11-29") != string::npos) {
-                late_nov.push_back(data);
+            else {
+                ss << "  Sudden spike: " << setprecision(1) << a->z_score << " standard deviations above recent levels"
+                    << " (previous reading " << setprecision(0) << a->previous << ")\n";
             }
         }
+        return ss.str();
+    }
+
+    // Inverse of dateToDayNumber.
+    static string dayNumberToDate(int days) {
+        days += 719468;
+        int era = (days >= 0 ? days : days - 146096) / 146097;
+        int doe = days - era * 146097;
+        int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int y = yoe + era * 400;
+        int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int mp = (5 * doy + 2) / 153;
+        int d = doy - (153 * mp + 2) / 5 + 1;
+        int m = mp + (mp < 10 ? 3 : -9);
+        char buf[36];   // three full-range ints, two dashes
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", y + (m <= 2), m, d);
+        return buf;
+    }
+
+    // Days since 1970-01-01 for a YYYY-MM-DD string (civil calendar).
+    static int dateToDayNumber(const string& date) {
+        int y = 0, m = 0, d = 0;
+        if (sscanf(date.c_str(), "%d-%d-%d", &y, &m, &d) != 3) return 0;
+        y -= m <= 2;
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yoe = y - era * 400;
+        int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    string analyzeTrends() {
+        // Simple trend analysis - compare first and last week
+        QueryPlan early, late;
+        early.day_from = dateToDayNumber("2025-11-01");
+        early.day_to = dateToDayNumber("2025-11-03");
+        late.day_from = dateToDayNumber("2025-11-27");
+        late.day_to = dateToDayNumber("2025-11-29");
+        vector<ResultRow> early_nov = runPlan(early), late_nov = runPlan(late);
 
         if (early_nov.empty() || late_nov.empty()) {
             return "Not enough data for trend analysis.";
         }
 
-        // Calculate averages
-        double early_avg = 0, late_avg = 0;
-        for (const auto& data : early_nov) early_avg += data.apiReading;
-        for (const auto& data : late_nov) late_avg += data.apiReading;
-        early_avg /= early_nov.size();
-        late_avg /= late_nov.size();
+        QueryAnswer answer;
+        answer.intent = "trend";
+        answer.period = "2025-11-01..2025-11-29";
+        answer.aggregate("early_average", early_nov[0].average());
+        answer.aggregate("late_average", late_nov[0].average());
+        answer.aggregate("change", late_nov[0].average() - early_nov[0].average());
+        return present(answer);
+    }
 
+    string renderTrend(const QueryAnswer& answer) {
         stringstream ss;
         ss << "Air Quality Trend Analysis (Early vs Late November):\n";
-        ss << "• Early Nov (1st-3rd): Average API " << fixed << setprecision(1) << early_avg << "\n";
-        ss << "• Late Nov (27th-29th): Average API " << fixed << setprecision(1) << late_avg << "\n";
+        ss << "• Early Nov (1st-3rd): Average API " << fixed << setprecision(1) << answer.get("early_average") << "\n";
+        ss << "• Late Nov (27th-29th): Average API " << fixed << setprecision(1) << answer.get("late_average") << "\n";
 
-        double change = late_avg - early_avg;
+        double change = answer.get("change");
         if (change > 5) ss << "• Overall: Air quality has worsened\n";
         else if (change < -5) ss << "• Overall: Air quality has improved\n";
         else ss << "• Overall: Air quality remained relatively stable\n";
@@ -925,14 +2795,14 @@ private:
     }
 
     string getHistoricalSummary() {
-        if (api_data_.empty()) return "No data available.";
+        if (recordCount() == 0) return "No data available.";
 
         stringstream ss;
         ss << "Historical Data Summary (Oct 29 - Nov 29, 2025):\n";
-        ss << "• Total records: " << api_data_.size() << "\n";
+        ss << "• Total records: " << recordCount() << "\n";
         ss << "• Monitoring period: 32 days\n";
         ss << "• Districts covered: " << countUniqueDistricts() << "\n";
-        ss << "• Data points per district: " << api_data_.size() / countUniqueDistricts() << "\n";
+        ss << "• Data points per district: " << recordCount() / countUniqueDistricts() << "\n";
         ss << "\nAsk me about specific dates, trends, or comparisons!";
 
         return ss.str();
@@ -942,43 +2812,35 @@ private:
         string lower_msg = user_message;
         transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
 
-        vector<APIData> october_data, november_data;
-
-        for (const auto& data : api_data_) {
-            if (data.date.find("2025-10") != string::npos) {
-                october_data.push_back(data);
-            }
-            else if (data.date.find("2025-11") != string::npos) {
-                november_data.push_back(data);
-            }
+        // One row per month present in the data.
+        ResultRow october_data, november_data;
+        for (const auto& row : runPlan(planForIntent("month"))) {
+            if (row.group == 2025 * 12 + 9) october_data = row;
+            else if (row.group == 2025 * 12 + 10) november_data = row;
         }
 
         stringstream ss;
 
         if (lower_msg.find("october") != string::npos) {
-            if (october_data.empty()) {
+            if (october_data.count == 0) {
                 ss << "Limited October data available (only 3 days).\n";
             }
             else {
-                double avg = 0;
-                for (const auto& data : october_data) avg += data.apiReading;
-                avg /= october_data.size();
+                double avg = october_data.average();
 
                 ss << "October 2025 Analysis (3 days):\n";
                 ss << "• Average API: " << fixed << setprecision(1) << avg << "\n";
-                ss << "• Days recorded: " << october_data.size() << "\n";
+                ss << "• Days recorded: " << october_data.count << "\n";
                 ss << "• Generally showed higher pollution levels\n";
             }
         }
 
         if (lower_msg.find("november") != string::npos) {
-            double avg = 0;
-            for (const auto& data : november_data) avg += data.apiReading;
-            avg /= november_data.size();
+            double avg = november_data.average();
 
             ss << "November 2025 Analysis (29 days):\n";
             ss << "• Average API: " << fixed << setprecision(1) << avg << "\n";
-            ss << "• Days recorded: " << november_data.size() << "\n";
+            ss << "• Days recorded: " << november_data.count << "\n";
             ss << "• Showed improving trend throughout the month\n";
         }
 
@@ -987,70 +2849,56 @@ private:
 
     string compareAreasOrTime(const string& user_message) {
         // Simple comparison - show top 5 areas by average
-        map<string, vector<int>> area_readings;
-
-        for (const auto& data : api_data_) {
-            string key = data.district + "," + data.state;
-            area_readings[key].push_back(data.apiReading);
-        }
-
-        vector<pair<string, double>> averages;
-        for (const auto& pair : area_readings) {
-            double sum = 0;
-            for (int reading : pair.second) sum += reading;
-            averages.push_back({ pair.first, sum / pair.second.size() });
-        }
-
-        sort(averages.begin(), averages.end(),
-            [](const pair<string, double>& a, const pair<string, double>& b) { return a.second > b.second; });
+        return present(areaAverages("compare"));
+    }
 
+    string renderComparison(const QueryAnswer& answer) {
         stringstream ss;
         ss << "Area Comparison (Average API Nov 2025):\n";
-        for (int i = 0; i < min(5, (int)averages.size()); i++) {
-            ss << "• " << averages[i].first << ": " << fixed << setprecision(1) << averages[i].second << "\n";
+        for (const auto& r : answer.records) {
+            ss << "• " << r.district << ", " << r.state << ": " << fixed << setprecision(1) << r.api << "\n";
         }
 
         return ss.str();
     }
 
     string getStatistics() {
-        if (api_data_.empty()) return "No data available.";
-
-        int total = 0;
-        int good = 0, moderate = 0, unhealthy = 0;
-        int max_api = 0, min_api = 1000;
-
-        for (const auto& data : api_data_) {
-            total += data.apiReading;
-            if (data.status == "Good") good++;
-            else if (data.status == "Moderate") moderate++;
-            else if (data.status == "Unhealthy") unhealthy++;
-
-            if (data.apiReading > max_api) max_api = data.apiReading;
-            if (data.apiReading < min_api) min_api = data.apiReading;
-        }
-
-        double average = static_cast<double>(total) / api_data_.size();
+        if (recordCount() == 0) return "No data available.";
+
+        vector<ResultRow> rows = runPlan(planForIntent("stats"));
+        if (rows.empty()) return "No data available.";
+        const ResultRow& all = rows[0];
+
+        QueryAnswer answer;
+        answer.intent = "stats";
+        answer.subject = "Malaysia";
+        answer.aggregate("records", static_cast<double>(recordCount()));
+        answer.aggregate("districts", countUniqueDistricts());
+        answer.aggregate("average", all.average());
+        answer.aggregate("max", all.max);
+        answer.aggregate("min", all.min);
+        answer.aggregate("good", all.status_counts[ColumnTable::GOOD]);
+        answer.aggregate("moderate", all.status_counts[ColumnTable::MODERATE]);
+        answer.aggregate("unhealthy", all.status_counts[ColumnTable::UNHEALTHY]);
+        return present(answer);
+    }
 
+    string renderStatistics(const QueryAnswer& answer) {
         stringstream ss;
         ss << "Malaysia Air Quality Statistics (Oct 29 - Nov 29):\n";
-        ss << "• Total records: " << api_data_.size() << "\n";
-        ss << "• Districts monitored: " << countUniqueDistricts() << "\n";
-        ss << "• Average API: " << fixed << setprecision(1) << average << "\n";
-        ss << "• Highest API: " << max_api << "\n";
-        ss << "• Lowest API: " << min_api << "\n";
-        ss << "• Good: " << good << " readings\n";
-        ss << "• Moderate: " << moderate << " readings\n";
-        ss << "• Unhealthy: " << unhealthy << " readings";
+        ss << "• Total records: " << static_cast<size_t>(answer.get("records")) << "\n";
+        ss << "• Districts monitored: " << static_cast<int>(answer.get("districts")) << "\n";
+        ss << "• Average API: " << fixed << setprecision(1) << answer.get("average") << "\n";
+        ss << "• Highest API: " << static_cast<int>(answer.get("max")) << "\n";
+        ss << "• Lowest API: " << static_cast<int>(answer.get("min")) << "\n";
+        ss << "• Good: " << static_cast<size_t>(answer.get("good")) << " readings\n";
+        ss << "• Moderate: " << static_cast<size_t>(answer.get("moderate")) << " readings\n";
+        ss << "• Unhealthy: " << static_cast<size_t>(answer.get("unhealthy")) << " readings";
         return ss.str();
     }
 
     int countUniqueDistricts() {
-        map<string, bool> districts;
-        for (const auto& data : api_data_) {
-            districts[data.district + data.state] = true;
-        }
-        return districts.size();
+        return static_cast<int>(shards_ ? shards_->areaCount() : columns().areaCount());
     }
 
     string getRandomResponse() {
@@ -1070,14 +2918,709 @@ void printHeader() {
     cout << "- Health advice: 'can I go out today?', 'is it safe to exercise in KL?'\n";
     cout << "- Rankings: 'cleanest areas', 'most polluted ranking', 'top 10'\n";
     cout << "- Trends and comparisons\n";
+    cout << "- Charts: 'graph KL', 'plot Selangor svg'\n";
+    cout << "- Forecasts: 'tomorrow in Penang', 'forecast KL'\n";
+    cout << "- Alerts: 'any alerts?', 'pollution spikes'\n";
+    cout << "- System: 'memory', 'memory budget 64', 'metrics', 'json <question>'\n";
+    cout << "- Data: 'ingest Klang,Selangor,87,Moderate,2025-12-01', 'checkpoint'\n";
     cout << "Press ESC at any time to exit.\n\n";
 }
 
-int main() {
+// Reads an n8n forecast payload (file or "-" for stdin) and prints the
+// {days, pm10, pm25, uvi} arrays aligned on day, for the graph node.
+int runAlignMode(const string& path) {
+    stringstream buffer;
+    if (path == "-") {
+        buffer << cin.rdbuf();
+    }
+    else {
+        ifstream file(path);
+        if (!file.is_open()) {
+            cerr << "Error: Could not open file " << path << endl;
+            return 1;
+        }
+        buffer << file.rdbuf();
+    }
+
+    vector<MetricSeries> series;
+    string error;
+    ForecastJsonParser parser;
+    if (!parser.parse(buffer.str(), series, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    cout << alignSeries(series, { "pm10", "pm25", "uvi" }).toJson() << "\n";
+    return 0;
+}
+
+// Server mode: one query per line on a Unix socket; each answer goes back
+// in HTTP-style chunks ("<hex length>\r\n<data>\r\n", ending "0\r\n\r\n"),
+// one chunk per page, so long listings start arriving before they are
+// fully rendered. Requests from every connection pass admission control:
+// cached answers go back at once, the rest wait in a bounded queue that
+// runs cheap intents first, and shed requests get a degraded answer.
+// Answers on one connection always go back in request order; an answer
+// that overtook an earlier request on its connection waits in `ready`.
+// Sockets are non-blocking: each connection queues its output and writes
+// it as the client reads, so a slow reader never holds up the others.
+// Past kMaxBuffered bytes of output and waiting answers, the connection is
+// not read and its requests wait unrendered for their turn; one whose
+// output makes no progress for the stall timeout is dropped, its requests
+// counted as shed. A client that shuts down its sending side still gets
+// every answer.
+#ifdef _WIN32
+int runServeMode(const string& socket_path, AirPollutantAI& bot, AdmissionOptions options) {
+    cerr << "Error: --serve needs Unix domain sockets" << endl;
+    return 1;
+}
+#else
+bool writeAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeChunk(int fd, const string& data) {
+    if (data.empty()) return true;   // an empty chunk would end the response
+    stringstream header;
+    header << hex << data.size() << "\r\n";
+    return writeAll(fd, header.str() + data + "\r\n");
+}
+
+bool unixAddress(const string& socket_path, sockaddr_un& addr) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) return false;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+// Listening socket on `socket_path` (replacing a stale one), or -1.
+int listenUnix(const string& socket_path, int backlog) {
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    if (server < 0 || !unixAddress(socket_path, addr)) {
+        cerr << "Error: Could not create socket " << socket_path << endl;
+        if (server >= 0) close(server);
+        return -1;
+    }
+    unlink(socket_path.c_str());
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(server, backlog) < 0) {
+        cerr << "Error: Could not listen on " << socket_path << endl;
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+int connectUnix(const string& socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    if (fd < 0) return -1;
+    if (!unixAddress(socket_path, addr) || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int runServeMode(const string& socket_path, AirPollutantAI& bot, AdmissionOptions options) {
+    int server = listenUnix(socket_path, 16);
+    if (server < 0) return 1;
+    signal(SIGPIPE, SIG_IGN);
+    cout << "Serving on " << socket_path << "\n" << flush;
+
+    AdmissionControl admission(options);
+    bot.setAdmission(&admission);
+    using Clock = AdmissionControl::Clock;
+
+    struct Connection {
+        int fd = -1;
+        string pending;
+        string out;                      // written as the socket takes it
+        size_t out_sent = 0;
+        Clock::time_point progress;      // output last accepted by the socket
+        uint64_t next_seq = 0;           // sequence of the next request read
+        uint64_t next_send = 0;          // sequence of the next answer to write
+        map<uint64_t, string> ready;     // finished answers waiting for earlier ones
+        size_t ready_bytes = 0;
+        map<uint64_t, AdmissionControl::Request> held;   // admitted, rendered when next
+        size_t outstanding = 0;
+        bool open = true;
+        bool reading = true;             // false once the client stops sending
+
+        size_t unsent() const { return out.size() - out_sent; }
+        size_t buffered() const { return unsent() + ready_bytes; }
+    };
+    map<uint64_t, Connection> connections;
+    uint64_t next_connection = 1;
+    const size_t kMaxLine = 4096;
+    const size_t kMaxBuffered = 1u << 20;
+
+    // Write what the socket takes now; the rest goes out on POLLOUT.
+    auto flushOut = [&](Connection& c) {
+        while (c.open && c.out_sent < c.out.size()) {
+            ssize_t n = write(c.fd, c.out.data() + c.out_sent, c.out.size() - c.out_sent);
+            if (n > 0) {
+                c.out_sent += static_cast<size_t>(n);
+                c.progress = Clock::now();
+            }
+            else if (n < 0 && errno == EINTR) continue;
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            else c.open = false;
+        }
+        if (!c.open || c.out_sent == c.out.size()) {
+            c.out.clear();
+            c.out_sent = 0;
+        }
+        else if (c.out_sent >= kMaxLine && c.out_sent * 2 >= c.out.size()) {
+            c.out.erase(0, c.out_sent);
+            c.out_sent = 0;
+        }
+    };
+    auto send = [&](Connection& c, const string& data) {
+        if (!c.open || data.empty()) return;
+        if (!c.unsent()) c.progress = Clock::now();
+        c.out += data;
+        flushOut(c);
+    };
+    auto chunk = [](const string& data) {
+        if (data.empty()) return string();   // an empty chunk would end the response
+        stringstream header;
+        header << hex << data.size() << "\r\n";
+        return header.str() + data + "\r\n";
+    };
+
+    auto flushReady = [&](Connection& c) {
+        for (auto it = c.ready.begin(); it != c.ready.end() && it->first == c.next_send; it = c.ready.erase(it)) {
+            send(c, it->second);
+            c.ready_bytes -= it->second.size();
+            c.next_send++;
+            c.outstanding--;
+        }
+    };
+    // A finished answer: queued for writing if it is next on its connection.
+    auto finish = [&](uint64_t id, const string& text) {
+        auto it = connections.find(id >> 32);
+        if (it == connections.end()) return;
+        Connection& c = it->second;
+        string body = chunk(text) + "0\r\n\r\n";
+        c.ready_bytes += body.size();
+        c.ready[id & 0xffffffffu] = move(body);
+        flushReady(c);
+    };
+    auto run = [&](const AdmissionControl::Request& request) {
+        auto it = connections.find(request.id >> 32);
+        if (it == connections.end()) return;
+        Connection& c = it->second;
+        if (!c.open) { finish(request.id, ""); return; }   // the client has gone
+        uint64_t seq = request.id & 0xffffffffu;
+        if ((seq == c.next_send ? c.unsent() : c.buffered()) >= kMaxBuffered) {
+            c.held[seq] = request;
+            return;
+        }
+        auto started = Clock::now();
+        if (seq == c.next_send) {
+            bot.streamResponse(request.query, [&](const string& text) { send(c, chunk(text)); });
+            send(c, "0\r\n\r\n");
+            c.next_send++;
+            c.outstanding--;
+            flushReady(c);
+        }
+        else {
+            string body;
+            bot.streamResponse(request.query, [&](const string& text) { body += chunk(text); });
+            body += "0\r\n\r\n";
+            c.ready_bytes += body.size();
+            c.ready[seq] = move(body);
+        }
+        admission.completed(request, chrono::duration<double, milli>(Clock::now() - started).count());
+    };
+    auto shed = [&](const AdmissionControl::Request& request) {
+        bool stale;
+        string text = bot.degradedResponse(request.query, stale);
+        admission.degraded(stale);
+        finish(request.id, text);
+    };
+
+    for (;;) {
+        vector<pollfd> fds{ { server, POLLIN, 0 } };
+        vector<uint64_t> ids;
+        for (auto& c : connections) {
+            if (!c.second.open) continue;
+            short events = 0;
+            if (c.second.reading && c.second.buffered() < kMaxBuffered) events |= POLLIN;
+            if (c.second.unsent()) events |= POLLOUT;
+            if (!events) continue;
+            fds.push_back({ c.second.fd, events, 0 });
+            ids.push_back(c.first);
+        }
+        auto wait = admission.wait(Clock::now());
+        for (auto& c : connections) {
+            if (c.second.open && c.second.unsent()) {
+                wait = min(wait, max(Clock::duration::zero(), c.second.progress + admission.stallTimeout() - Clock::now()));
+            }
+        }
+        int timeout = wait == Clock::duration::max() ? -1 :
+            static_cast<int>(chrono::duration_cast<chrono::milliseconds>(wait).count());
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) return 1;
+
+        if (fds[0].revents & POLLIN) {
+            int client = accept(server, nullptr, nullptr);
+            if (client >= 0) {
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                connections[next_connection++].fd = client;
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            Connection& c = connections[ids[i - 1]];
+            if (fds[i].revents & (POLLOUT | POLLHUP | POLLERR)) flushOut(c);
+            if (!(fds[i].events & POLLIN) || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            char buffer[4096];
+            ssize_t n = read(c.fd, buffer, sizeof(buffer));
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c.open = false;
+                continue;
+            }
+            if (n == 0) {
+                // End of requests; the queued ones are still answered.
+                c.reading = false;
+                if (!c.pending.empty()) c.pending += '\n';   // a last line without a newline
+            }
+            else c.pending.append(buffer, static_cast<size_t>(n));
+
+            size_t newline;
+            while ((newline = c.pending.find('\n')) != string::npos) {
+                string query = c.pending.substr(0, newline);
+                c.pending.erase(0, newline + 1);
+                if (!query.empty() && query.back() == '\r') query.pop_back();
+                if (query.empty()) continue;
+
+                AdmissionControl::Request request;
+                request.id = ids[i - 1] << 32 | c.next_seq++;
+                request.query = query;
+                c.outstanding++;
+                string cached;
+                if (bot.cachedResponse(query, cached)) {
+                    admission.cacheHit();
+                    finish(request.id, cached);
+                    continue;
+                }
+                request.intent = bot.intentOf(query);
+                if (!admission.offer(request, Clock::now())) shed(request);
+            }
+            if (c.pending.size() > kMaxLine) {
+                // Answered in turn, after which the connection closes.
+                c.outstanding++;
+                finish(ids[i - 1] << 32 | c.next_seq++, "Query too long.");
+                c.pending.clear();
+                c.reading = false;
+            }
+        }
+
+        // One request per pass, so new arrivals are queued (and costed)
+        // before the next choice.
+        AdmissionControl::Request request;
+        vector<AdmissionControl::Request> expired;
+        bool runnable = admission.next(Clock::now(), request, expired);
+        for (const auto& e : expired) shed(e);
+        if (runnable) {
+            string cached;
+            if (bot.cachedResponse(request.query, cached)) {
+                admission.cacheHit();
+                finish(request.id, cached);
+            }
+            else run(request);
+        }
+        for (auto& c : connections) {
+            auto& held = c.second.held;
+            while (!held.empty() && held.begin()->first == c.second.next_send && c.second.unsent() < kMaxBuffered) {
+                AdmissionControl::Request next = held.begin()->second;
+                held.erase(held.begin());
+                run(next);
+            }
+        }
+
+        // Drop clients that stopped reading, with everything they still wait for.
+        for (auto& entry : connections) {
+            Connection& c = entry.second;
+            if (!c.open || !c.unsent() || Clock::now() - c.progress < admission.stallTimeout()) continue;
+            uint64_t id = entry.first;
+            admission.cancel([id](const AdmissionControl::Request& r) { return r.id >> 32 == id; });
+            admission.stalled(c.outstanding);
+            c.open = false;
+            c.held.clear();
+            c.ready.clear();
+            c.ready_bytes = 0;
+            c.outstanding = 0;
+        }
+
+        for (auto it = connections.begin(); it != connections.end();) {
+            // Keep a closed connection until its queued requests are gone,
+            // and a finished one until its answers are written.
+            const Connection& c = it->second;
+            if ((!c.open || !c.reading) && c.outstanding == 0 && (!c.open || c.out.empty())) {
+                close(it->second.fd);
+                it = connections.erase(it);
+            }
+            else ++it;
+        }
+    }
+}
+#endif
+
+// Sharded mode: `--shards N` forks N worker processes. Each loads only its
+// shard of the data file and answers ShardCluster requests from the
+// coordinator on its own Unix socket: a request line in, response lines
+// and a "." line out. Workers exit when the coordinator goes away.
+#ifdef _WIN32
+bool startShardWorkers(size_t count, const string& data_file, ShardCluster& cluster) {
+    cerr << "Error: --shards needs Unix domain sockets" << endl;
+    return false;
+}
+#else
+string shardCall(int fd, const string& request) {
+    if (!writeAll(fd, request + "\n")) return "";
+    string reply;
+    char buffer[4096];
+    while (reply != ".\n" && (reply.size() < 3 || reply.compare(reply.size() - 3, 3, "\n.\n") != 0)) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            cerr << "Warning: Lost connection to a shard worker" << endl;
+            return "";
+        }
+        reply.append(buffer, static_cast<size_t>(n));
+    }
+    reply.resize(reply.size() - 2);
+    return reply;
+}
+
+int runShardWorker(const string& socket_path, const string& data_file, size_t shard, size_t count) {
+    cout.rdbuf(nullptr);   // load messages would interleave with the coordinator's output
+    AirPollutantAI worker(data_file, shard, count);
+    int server = listenUnix(socket_path, 1);
+    if (server < 0) return 1;
+    int client = accept(server, nullptr, nullptr);
+    close(server);
+    if (client < 0) return 1;
+
+    string pending;
+    char buffer[4096];
+    for (;;) {
+        ssize_t n = read(client, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        pending.append(buffer, static_cast<size_t>(n));
+
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos) {
+            string request = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (!writeAll(client, worker.answerShardRequest(request) + ".\n")) return 1;
+        }
+    }
+    close(client);
+    return 0;
+}
+
+bool startShardWorkers(size_t count, const string& data_file, ShardCluster& cluster) {
+    cout << flush;
+    vector<pair<pid_t, string>> workers;
+    for (size_t i = 0; i < count; i++) {
+        string path = "/tmp/chatbox-" + to_string(getpid()) + "-shard" + to_string(i) + ".sock";
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Error: Could not start shard worker " << i << endl;
+            return false;
+        }
+        if (pid == 0) {
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            _exit(runShardWorker(path, data_file, i, count));
+        }
+        workers.push_back({ pid, path });
+    }
+
+    // Workers load in parallel; connect to each once its socket is up.
+    vector<int> fds;
+    for (const auto& worker : workers) {
+        int fd = -1;
+        while ((fd = connectUnix(worker.second)) < 0) {
+            int status;
+            if (waitpid(worker.first, &status, WNOHANG) != 0) {
+                cerr << "Error: Shard worker for " << worker.second << " exited" << endl;
+                return false;
+            }
+            usleep(10000);
+        }
+        unlink(worker.second.c_str());
+        fds.push_back(fd);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    cluster.connect(count, [fds](size_t shard, const string& request) { return shardCall(fds[shard], request); });
+    return true;
+}
+#endif
+
+// Load generator: `--loadgen <rate,rate,...> [data] [--socket <path>]
+// [--mix <file>] [--duration <seconds>] [--svg <file>]`. Each rate runs for
+// the duration against this process's engine, or pipelined over one
+// connection to a `--serve` socket; the sweep stops after the first
+// saturated rate.
+int runLoadGenMode(const string& rate_list, AirPollutantAI& bot, const map<string, string>& options) {
+    vector<double> rates;
+    stringstream rs(rate_list);
+    string token;
+    while (getline(rs, token, ',')) {
+        double rate = atof(token.c_str());
+        if (rate > 0) rates.push_back(rate);
+    }
+    if (rates.empty()) {
+        cerr << "Error: --loadgen needs a comma-separated list of request rates" << endl;
+        return 1;
+    }
+    auto option = [&](const string& name) { auto it = options.find(name); return it == options.end() ? string() : it->second; };
+    double duration = option("--duration").empty() ? 5 : atof(option("--duration").c_str());
+
+    QueryMix mix = QueryMix::defaults();
+    if (!option("--mix").empty() && !mix.load(option("--mix"))) {
+        cerr << "Error: Could not read query mix " << option("--mix") << endl;
+        return 1;
+    }
+    vector<string> areas, dates;
+    bot.loadVocabulary(areas, dates);
+
+    string socket_path = option("--socket");
+#ifdef _WIN32
+    if (!socket_path.empty()) {
+        cerr << "Error: --socket needs Unix domain sockets" << endl;
+        return 1;
+    }
+#else
+    int fd = -1;
+    if (!socket_path.empty() && (fd = connectUnix(socket_path)) < 0) {
+        cerr << "Error: Could not connect to " << socket_path << endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    // One chunked answer: "<hex length>\r\n<data>\r\n" chunks up to a zero-length one.
+    string pending;
+    auto fill = [&](size_t n) {
+        char buffer[65536];
+        while (pending.size() < n) {
+            ssize_t got = read(fd, buffer, sizeof(buffer));
+            if (got <= 0) return false;
+            pending.append(buffer, static_cast<size_t>(got));
+        }
+        return true;
+    };
+    auto awaitReply = [&]() {
+        size_t at = 0;
+        for (;;) {
+            size_t eol;
+            while ((eol = pending.find("\r\n", at)) == string::npos) {
+                if (!fill(pending.size() + 1)) return false;
+            }
+            size_t length = strtoul(pending.c_str() + at, nullptr, 16);
+            if (!fill(eol + 2 + length + 2)) return false;
+            at = eol + 2 + length + 2;
+            if (length == 0) break;
+        }
+        pending.erase(0, at);
+        return true;
+    };
+#endif
+
+    cout << "Open-loop load: " << mix.entries().size() << " query templates, " << duration << " s per rate, "
+        << (socket_path.empty() ? "in process" : "over " + socket_path) << "\n\n" << flush;
+    vector<LoadStep> steps;
+    for (size_t i = 0; i < rates.size(); i++) {
+        size_t count = max<size_t>(1, static_cast<size_t>(rates[i] * duration));
+        vector<LoadQuery> queries = mix.draw(count, areas, dates, static_cast<uint32_t>(i + 1));
+        if (socket_path.empty()) {
+            steps.push_back(LoadGenerator::runInProcess(queries, rates[i],
+                [&](const string& q) { bot.streamResponse(q, [](const string&) {}); }));
+        }
+#ifndef _WIN32
+        else {
+            steps.push_back(LoadGenerator::runPipelined(queries, rates[i],
+                [&](const string& q) { return writeAll(fd, q + "\n"); }, awaitReply));
+            if (steps.back().latency.count() < queries.size()) {
+                cerr << "Error: Lost connection to " << socket_path << endl;
+                return 1;
+            }
+        }
+#endif
+        cerr << "  " << rates[i] << "/s done\n";
+        if (steps.back().saturated()) break;
+    }
+#ifndef _WIN32
+    if (fd >= 0) close(fd);
+#endif
+    cout << LoadGenerator::report(steps);
+
+    if (!option("--svg").empty()) {
+        vector<ChartPoint> curve;
+        for (const auto& step : steps) curve.push_back({ step.achieved, step.latency.percentile(0.99) / 1000.0 });
+        ofstream svg(option("--svg"));
+        svg << renderSvg(curve, "p99 latency (ms) vs completed requests/s");
+        if (!svg) {
+            cerr << "Error: Could not write " << option("--svg") << endl;
+            return 1;
+        }
+        cout << "Wrote " << option("--svg") << "\n";
+    }
+    return 0;
+}
+
+// Bulk ingest of "district,state,api,status,date" lines from a file or
+// stdin ("-"). Rows are group-committed as they stream in; the run waits for
+// the last one to be durable before reporting.
+int runIngestMode(const string& source, AirPollutantAI& bot) {
+    ifstream file;
+    if (source != "-") {
+        file.open(source);
+        if (!file.is_open()) {
+            cerr << "Error: Could not open " << source << endl;
+            return 1;
+        }
+    }
+    istream& in = source == "-" ? cin : file;
+
+    auto start = chrono::steady_clock::now();
+    size_t rows = 0, skipped = 0;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        APIData record;
+        if (!AirPollutantAI::parseIngestLine(line, record)) {
+            skipped++;
+            continue;
+        }
+        bot.ingestReading(record);
+        rows++;
+    }
+    bot.syncLog();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    AppendLog* log = bot.appendLog();
+    if (log && log->failed()) {
+        cerr << "Error: Could not write " << log->path() << endl;
+        return 1;
+    }
+    cout << "Ingested " << rows << " readings in " << fixed << setprecision(2) << seconds << " s ("
+        << static_cast<size_t>(seconds > 0 ? rows / seconds : 0) << " rows/s";
+    if (log) cout << ", " << log->commits() << " group commits";
+    cout << ")";
+    if (skipped) cout << ", skipped " << skipped << " malformed lines";
+    cout << ".\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // `--parquet-range FROM:TO` (either side may be empty) limits what a
+    // Parquet source loads; it comes before everything else.
+    if (argc > 2 && string(argv[1]) == "--parquet-range") {
+        string range = argv[2];
+        size_t colon = range.find(':');
+        ParquetFilter& filter = AirPollutantAI::parquetRange();
+        filter.date_from = range.substr(0, colon);
+        filter.date_to = colon == string::npos ? string() : range.substr(colon + 1);
+        argc -= 2;
+        argv += 2;
+    }
+    // `--shards N` comes next and applies to the chat, --json and --serve modes.
+    ShardCluster cluster;
+    ShardCluster* shards = nullptr;
+    if (argc > 2 && string(argv[1]) == "--shards") {
+        size_t count = strtoul(argv[2], nullptr, 10);
+        argc -= 2;
+        argv += 2;
+        bool query_mode = argc > 1 && (string(argv[1]) == "--json" || string(argv[1]) == "--serve" || string(argv[1]) == "--ingest" ||
+            string(argv[1]) == "--loadgen");
+        int data_arg = query_mode ? 3 : 1;
+        string data_file = argc > data_arg && string(argv[data_arg]).compare(0, 2, "--") != 0 ? argv[data_arg] : "malaysia_api_1month_daily.txt";
+        if (count == 0 || PartitionManifest::exists(data_file)) {
+            cerr << "Error: --shards needs a worker count and a data file (not a partition directory)" << endl;
+            return 1;
+        }
+        if (!startShardWorkers(count, data_file, cluster)) return 1;
+        shards = &cluster;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--align") {
+        return runAlignMode(argv[2]);
+    }
+    if (argc > 1 && string(argv[1]) == "--check-parallel") {
+        size_t workers = argc > 2 ? max<size_t>(2, strtoul(argv[2], nullptr, 10)) : 4;
+        string diff = QueryEngine::checkWorkers(workers);
+        if (!diff.empty()) {
+            cerr << "Query plans differ between 1 and " << workers << " workers: " << diff << endl;
+            return 1;
+        }
+        cout << "Query plans agree between 1 and " << workers << " workers.\n";
+        return 0;
+    }
+    if (argc > 3 && string(argv[1]) == "--partition") {
+        AirPollutantAI source(argv[2]);
+        return source.writePartitions(argv[3]) ? 0 : 1;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--json") {
+        streambuf* out = cout.rdbuf(cerr.rdbuf());   // keep load messages off the JSON output
+        AirPollutantAI bot = argc > 3 ? AirPollutantAI(argv[3], shards) : AirPollutantAI("malaysia_api_1month_daily.txt", shards);
+        cout.rdbuf(out);
+        cout << bot.generateJson(argv[2]) << "\n";
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--ingest") {
+        AirPollutantAI bot = argc > 3 ? AirPollutantAI(argv[3], shards) : AirPollutantAI("malaysia_api_1month_daily.txt", shards);
+        return runIngestMode(argv[2], bot);
+    }
+
+    if (argc > 2 && string(argv[1]) == "--loadgen") {
+        map<string, string> options;
+        string data_file = "malaysia_api_1month_daily.txt";
+        for (int i = 3; i < argc; i++) {
+            string arg = argv[i];
+            if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) options[arg] = argv[++i];
+            else data_file = arg;
+        }
+        streambuf* out = cout.rdbuf(cerr.rdbuf());   // keep load messages out of the report
+        AirPollutantAI bot(data_file, shards);
+        cout.rdbuf(out);
+        return runLoadGenMode(argv[2], bot, options);
+    }
+
+    if (argc > 2 && string(argv[1]) == "--serve") {
+        // [data] [--queue N] [--deadline ms] [--expensive-share fraction] [--stall ms]
+        AdmissionOptions options;
+        string data_file = "malaysia_api_1month_daily.txt";
+        for (int i = 3; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--queue" && i + 1 < argc) options.queue_capacity = max<size_t>(1, strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--deadline" && i + 1 < argc) options.deadline_ms = atof(argv[++i]);
+            else if (arg == "--expensive-share" && i + 1 < argc) options.expensive_share = atof(argv[++i]);
+            else if (arg == "--stall" && i + 1 < argc) options.stall_ms = atof(argv[++i]);
+            else data_file = arg;
+        }
+        if (options.deadline_ms <= 0 || options.stall_ms <= 0 || options.expensive_share <= 0 || options.expensive_share > 1) {
+            cerr << "Error: --deadline and --stall must be positive and --expensive-share in (0, 1]" << endl;
+            return 1;
+        }
+        AirPollutantAI bot(data_file, shards);
+        return runServeMode(argv[2], bot, options);
+    }
+
     atexit(restore_mode);
     set_raw_mode();
 
-    AirPollutantAI bot;
+    AirPollutantAI bot = argc > 1 ? AirPollutantAI(argv[1], shards) : AirPollutantAI("malaysia_api_1month_daily.txt", shards);
     printHeader();
 
     string user_input = "";
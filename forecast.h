@@ -0,0 +1,254 @@
+#pragma once
+// Per-series daily forecasting with additive Holt-Winters (weekly season).
+// Models are fitted once over the loaded history, in parallel across series,
+// and then updated incrementally in O(1) as new daily readings arrive.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct HoltWintersModel {
+    static const int kSeason = 7;
+
+    double alpha = 0.5, beta = 0.1, gamma = 0.2;
+    bool seasonal = false;
+    double level = 0, trend = 0;
+    double season[kSeason] = { 0 };
+    long step = 0;            // observations folded into the state
+    double sse = 0;           // one-step-ahead squared error
+    long errors = 0;
+
+    double predict(int h) const {
+        double f = level + h * trend;
+        if (seasonal) f += season[(step + h - 1) % kSeason];
+        return f;
+    }
+
+    void update(double y) {
+        double expected = predict(1);
+        sse += (y - expected) * (y - expected);
+        errors++;
+
+        double s = seasonal ? season[step % kSeason] : 0;
+        double prev_level = level;
+        level = alpha * (y - s) + (1 - alpha) * (level + trend);
+        trend = beta * (level - prev_level) + (1 - beta) * trend;
+        if (seasonal) season[step % kSeason] = gamma * (y - level) + (1 - gamma) * s;
+        step++;
+    }
+
+    // Like update(), but the very first observation just sets the level.
+    void feed(double y) {
+        if (step == 0) {
+            level = y;
+            step = 1;
+        }
+        else update(y);
+    }
+
+    double rmse() const { return errors > 0 ? std::sqrt(sse / errors) : 0; }
+
+    // Initialise from the first observations and run the rest through update().
+    // Uses a weekly season once two full weeks are available, Holt's linear
+    // trend otherwise.
+    void fit(const std::vector<double>& y) {
+        level = trend = 0;
+        std::fill(season, season + kSeason, 0.0);
+        step = 0;
+        sse = 0;
+        errors = 0;
+        seasonal = y.size() >= 2 * kSeason;
+        if (y.empty()) return;
+
+        size_t start;
+        if (seasonal) {
+            double first = 0, second = 0;
+            for (int i = 0; i < kSeason; i++) {
+                first += y[i];
+                second += y[i + kSeason];
+            }
+            first /= kSeason;
+            second /= kSeason;
+            level = first;
+            trend = (second - first) / kSeason;
+            for (int i = 0; i < kSeason; i++) season[i] = y[i] - first;
+            step = kSeason;
+            start = kSeason;
+            // Level should reflect the end of the first season, not its middle.
+            level += trend * (kSeason - 1) / 2.0;
+        }
+        else {
+            level = y[0];
+            trend = y.size() > 1 ? y[1] - y[0] : 0;
+            step = 1;
+            start = 1;
+        }
+        for (size_t i = start; i < y.size(); i++) update(y[i]);
+    }
+};
+
+// One forecast series (a district) with its pending, not yet folded day.
+struct DistrictForecast {
+    std::string district;
+    std::string state;
+    HoltWintersModel model;
+    int last_day = -1;        // last day folded into the model
+    int pending_day = -1;     // day currently accumulating readings
+    double pending_sum = 0;
+    int pending_count = 0;
+
+    int latestDay() const { return pending_day >= 0 ? pending_day : last_day; }
+
+    // Forecast `h` days past the latest observed day, with the pending day
+    // folded into a copy of the state.
+    double forecast(int h) const {
+        HoltWintersModel m = model;
+        if (pending_count > 0) {
+            for (int d = last_day + 1; last_day >= 0 && d < pending_day; d++) m.update(m.predict(1));
+            m.feed(pending_sum / pending_count);
+        }
+        return std::max(0.0, m.predict(h));
+    }
+
+    void fold() {
+        if (pending_count == 0) return;
+        // Missing days are imputed with the model's own one-step forecast.
+        for (int d = last_day + 1; last_day >= 0 && d < pending_day; d++) model.update(model.predict(1));
+        model.feed(pending_sum / pending_count);
+        last_day = pending_day;
+        pending_count = 0;
+        pending_sum = 0;
+    }
+
+    void observe(int day, double value) {
+        if (day < latestDay()) return;   // late data does not rewrite history
+        if (day != pending_day) {
+            fold();
+            pending_day = day;
+        }
+        pending_sum += value;
+        pending_count++;
+    }
+};
+
+class ForecastEngine {
+public:
+    // Raw (day number, value) readings of one series, in any order.
+    struct SeriesInput {
+        std::string district;
+        std::string state;
+        std::vector<std::pair<int, double>> readings;
+    };
+
+    // Fit every series, spreading them over the available cores. Smoothing
+    // parameters are chosen per series by a small grid search on one-step
+    // error.
+    void fit(std::map<std::string, SeriesInput>& inputs) {
+        models_.clear();
+        std::vector<std::pair<const std::string*, SeriesInput*>> work;
+        for (auto& pair : inputs) work.push_back({ &pair.first, &pair.second });
+
+        std::vector<DistrictForecast> results(work.size());
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            size_t i;
+            while ((i = next++) < work.size()) results[i] = fitSeries(*work[i].second);
+        };
+
+        unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), work.size()));
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+
+        for (size_t i = 0; i < work.size(); i++) models_[*work[i].first] = std::move(results[i]);
+    }
+
+    void observe(const std::string& key, const std::string& district, const std::string& state, int day, double value) {
+        auto it = models_.find(key);
+        if (it == models_.end()) {
+            DistrictForecast f;
+            f.district = district;
+            f.state = state;
+            it = models_.emplace(key, f).first;
+        }
+        it->second.observe(day, value);
+    }
+
+    const std::map<std::string, DistrictForecast>& models() const { return models_; }
+
+private:
+    static DistrictForecast fitSeries(SeriesInput& input) {
+        DistrictForecast f;
+        f.district = input.district;
+        f.state = input.state;
+        if (input.readings.empty()) return f;
+
+        // Collapse to one mean value per day and impute gaps linearly.
+        std::sort(input.readings.begin(), input.readings.end());
+        std::vector<std::pair<int, double>> days;
+        double newest_sum = 0;
+        int newest_count = 0;
+        for (size_t i = 0; i < input.readings.size();) {
+            int day = input.readings[i].first;
+            double sum = 0;
+            int count = 0;
+            for (; i < input.readings.size() && input.readings[i].first == day; i++, count++) sum += input.readings[i].second;
+            days.push_back({ day, sum / count });
+            newest_sum = sum;
+            newest_count = count;
+        }
+
+        // The newest day stays pending so further readings for it can still
+        // be merged in before it is folded into the model.
+        int newest_day = days.back().first;
+        days.pop_back();
+
+        std::vector<double> y;
+        for (size_t i = 0; i < days.size(); i++) {
+            if (i > 0) {
+                int gap = days[i].first - days[i - 1].first;
+                for (int g = 1; g < gap; g++) {
+                    y.push_back(days[i - 1].second + (days[i].second - days[i - 1].second) * g / gap);
+                }
+            }
+            y.push_back(days[i].second);
+        }
+
+        static const double alphas[] = { 0.1, 0.3, 0.5, 0.7, 0.9 };
+        static const double betas[] = { 0.01, 0.1, 0.3 };
+        static const double gammas[] = { 0.05, 0.2, 0.5 };
+        HoltWintersModel best;
+        best.fit(y);
+        double best_err = best.rmse();
+        for (double a : alphas) {
+            for (double b : betas) {
+                for (double g : gammas) {
+                    HoltWintersModel m;
+                    m.alpha = a;
+                    m.beta = b;
+                    m.gamma = g;
+                    m.fit(y);
+                    if (m.rmse() < best_err) {
+                        best_err = m.rmse();
+                        best = m;
+                    }
+                    if (!m.seasonal) break;   // gamma is unused without a season
+                }
+            }
+        }
+
+        f.model = best;
+        f.last_day = days.empty() ? -1 : days.back().first;
+        f.pending_day = newest_day;
+        f.pending_sum = newest_sum;
+        f.pending_count = newest_count;
+        return f;
+    }
+
+    std::map<std::string, DistrictForecast> models_;
+};
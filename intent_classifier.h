@@ -0,0 +1,219 @@
+#pragma once
+// Offline intent classifier: hashed word/bigram/char-trigram features and a
+// linear softmax model stored as int8 weights. Inference sums one contiguous
+// int8 row per feature into int32 class scores, eight classes at a time with
+// AVX2 (chosen at run time on x86-64 GCC/Clang) or NEON, scalar otherwise; a
+// few microseconds per message. Models are produced by intent_train.cpp from
+// a labeled query file.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "memory_accounting.h"
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+struct IntentPrediction {
+    int label = -1;
+    float confidence = 0;
+};
+
+class IntentFeaturizer {
+public:
+    explicit IntentFeaturizer(uint32_t buckets = 4096) : buckets_(buckets) {}
+
+    uint32_t buckets() const { return buckets_; }
+
+    // Sorted, de-duplicated feature buckets for a message.
+    std::vector<uint32_t> features(const std::string& text) const {
+        std::vector<std::string> words;
+        std::string word;
+        for (char c : text) {
+            if (isalnum(static_cast<unsigned char>(c))) word += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            else if (!word.empty()) { words.push_back(word); word.clear(); }
+        }
+        if (!word.empty()) words.push_back(word);
+
+        std::vector<uint32_t> out;
+        for (size_t i = 0; i < words.size(); i++) {
+            // Digits are collapsed so "29 nov" and "3 nov" share features.
+            std::string w = words[i];
+            if (isdigit(static_cast<unsigned char>(w[0]))) w = "<num>";
+            out.push_back(hash("w:", w));
+            if (i + 1 < words.size()) {
+                std::string next = isdigit(static_cast<unsigned char>(words[i + 1][0])) ? "<num>" : words[i + 1];
+                out.push_back(hash("b:", w + " " + next));
+            }
+            std::string padded = "#" + w + "#";
+            for (size_t j = 0; j + 3 <= padded.size(); j++) out.push_back(hash("c:", padded.substr(j, 3)));
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+private:
+    uint32_t hash(const char* prefix, const std::string& s) const {
+        uint32_t h = 2166136261u;   // FNV-1a
+        for (const char* p = prefix; *p; p++) { h ^= static_cast<uint8_t>(*p); h *= 16777619u; }
+        for (char c : s) { h ^= static_cast<uint8_t>(c); h *= 16777619u; }
+        return h % buckets_;
+    }
+
+    uint32_t buckets_;
+};
+
+class IntentClassifier {
+public:
+    bool loaded() const { return !labels_.empty(); }
+    const std::vector<std::string>& labels() const { return labels_; }
+    int labelIndex(const std::string& name) const {
+        for (size_t i = 0; i < labels_.size(); i++) if (labels_[i] == name) return static_cast<int>(i);
+        return -1;
+    }
+
+    IntentPrediction predict(const std::string& text) const {
+        IntentPrediction result;
+        if (!loaded()) return result;
+
+        size_t classes = labels_.size();
+        std::vector<uint32_t> feats = featurizer_.features(text);
+        if (feats.empty()) return result;
+
+        std::vector<int32_t> acc(classes, 0);
+        for (uint32_t f : feats) accumulate(&weights_[static_cast<size_t>(f) * classes], acc.data(), classes);
+
+        float norm = scale_ / std::sqrt(static_cast<float>(feats.size()));
+        std::vector<float> logits(classes);
+        float max_logit = -1e30f;
+        for (size_t c = 0; c < classes; c++) {
+            logits[c] = acc[c] * norm + bias_[c];
+            max_logit = std::max(max_logit, logits[c]);
+        }
+        float sum = 0;
+        for (size_t c = 0; c < classes; c++) {
+            logits[c] = std::exp(logits[c] - max_logit);
+            sum += logits[c];
+        }
+        for (size_t c = 0; c < classes; c++) {
+            if (result.label < 0 || logits[c] > logits[result.label]) result.label = static_cast<int>(c);
+        }
+        result.confidence = logits[result.label] / sum;
+        return result;
+    }
+
+    // Quantize float weights (row-major [bucket][class]) to int8 with one
+    // shared scale.
+    void setModel(const IntentFeaturizer& featurizer, const std::vector<std::string>& labels,
+        const std::vector<float>& weights, const std::vector<float>& bias) {
+        featurizer_ = featurizer;
+        labels_ = labels;
+        bias_ = bias;
+        float max_abs = 0;
+        for (float w : weights) max_abs = std::max(max_abs, std::fabs(w));
+        scale_ = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+        weights_.resize(weights.size());
+        for (size_t i = 0; i < weights.size(); i++) {
+            float q = std::round(weights[i] / scale_);
+            weights_[i] = static_cast<int8_t>(std::max(-127.0f, std::min(127.0f, q)));
+        }
+    }
+
+    bool save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out.is_open()) return false;
+        out.write("AQIC", 4);
+        uint32_t header[3] = { 1, featurizer_.buckets(), static_cast<uint32_t>(labels_.size()) };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto& label : labels_) {
+            uint32_t len = static_cast<uint32_t>(label.size());
+            out.write(reinterpret_cast<const char*>(&len), 4);
+            out.write(label.data(), len);
+        }
+        out.write(reinterpret_cast<const char*>(&scale_), sizeof(scale_));
+        out.write(reinterpret_cast<const char*>(bias_.data()), bias_.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(weights_.data()), weights_.size());
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open()) return false;
+        char magic[4];
+        uint32_t header[3];
+        if (!in.read(magic, 4) || memcmp(magic, "AQIC", 4) != 0) return false;
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 1) return false;
+        if (header[1] == 0 || header[2] == 0 || header[2] > 256) return false;
+
+        std::vector<std::string> labels(header[2]);
+        for (auto& label : labels) {
+            uint32_t len;
+            if (!in.read(reinterpret_cast<char*>(&len), 4) || len > 256) return false;
+            label.resize(len);
+            if (!in.read(&label[0], len)) return false;
+        }
+        float scale;
+        std::vector<float> bias(header[2]);
+        std::vector<int8_t> weights(static_cast<size_t>(header[1]) * header[2]);
+        if (!in.read(reinterpret_cast<char*>(&scale), sizeof(scale)) ||
+            !in.read(reinterpret_cast<char*>(bias.data()), bias.size() * sizeof(float)) ||
+            !in.read(reinterpret_cast<char*>(weights.data()), weights.size())) return false;
+
+        featurizer_ = IntentFeaturizer(header[1]);
+        labels_ = labels;
+        scale_ = scale;
+        bias_ = bias;
+        weights_.assign(weights.begin(), weights.end());
+        return true;
+    }
+
+private:
+    // acc[c] += row[c] for every class.
+    static void accumulate(const int8_t* row, int32_t* acc, size_t n) {
+#if defined(__AVX2__)
+        size_t c = accumulateAvx2(row, acc, n);
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        size_t c = avx2 ? accumulateAvx2(row, acc, n) : 0;
+#elif defined(__ARM_NEON)
+        size_t c = 0;
+        for (; c + 8 <= n; c += 8) {
+            int16x8_t w = vmovl_s8(vld1_s8(row + c));
+            vst1q_s32(acc + c, vaddw_s16(vld1q_s32(acc + c), vget_low_s16(w)));
+            vst1q_s32(acc + c + 4, vaddw_s16(vld1q_s32(acc + c + 4), vget_high_s16(w)));
+        }
+#else
+        size_t c = 0;
+#endif
+        for (; c < n; c++) acc[c] += row[c];
+    }
+
+#if defined(__AVX2__) || ((defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__))
+    // Sign-extends eight weights to int32 per step; returns the classes done.
+#if !defined(__AVX2__)
+    __attribute__((target("avx2")))
+#endif
+    static size_t accumulateAvx2(const int8_t* row, int32_t* acc, size_t n) {
+        size_t c = 0;
+        for (; c + 8 <= n; c += 8) {
+            __m256i w = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + c)));
+            __m256i* out = reinterpret_cast<__m256i*>(acc + c);
+            _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), w));
+        }
+        return c;
+    }
+#endif
+
+    IntentFeaturizer featurizer_;
+    std::vector<std::string> labels_;
+    TrackedVector<int8_t, MemSubsystem::INDEXES> weights_;   // [bucket][class]
+    std::vector<float> bias_;
+    float scale_ = 1.0f;
+};
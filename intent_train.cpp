@@ -0,0 +1,171 @@
+// Trains and evaluates the chatbox intent classifier.
+// Usage: intent_train [intent_queries.tsv] [intent_model.bin]
+// Reports 5-fold cross-validated accuracy (float and int8 weights) and
+// per-intent precision/recall, then trains on all examples and writes the
+// quantized model that chatbox.cpp loads at startup.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include "intent_classifier.h"
+using namespace std;
+
+struct Example {
+    int label;
+    string text;
+    vector<uint32_t> features;
+};
+
+struct FloatModel {
+    size_t classes;
+    vector<float> weights;   // [bucket][class]
+    vector<float> bias;
+};
+
+FloatModel train(const vector<const Example*>& data, uint32_t buckets, size_t classes, int epochs = 60) {
+    FloatModel m{ classes, vector<float>(static_cast<size_t>(buckets) * classes, 0.0f), vector<float>(classes, 0.0f) };
+    vector<const Example*> order = data;
+    mt19937 rng(7);
+    vector<float> probs(classes);
+    const float l2 = 1e-4f;
+
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        float lr = 0.5f / (1 + epoch * 0.05f);
+        shuffle(order.begin(), order.end(), rng);
+        for (const Example* ex : order) {
+            float x = 1.0f / sqrt(static_cast<float>(ex->features.size()));
+            float max_logit = -1e30f;
+            for (size_t c = 0; c < classes; c++) {
+                float z = m.bias[c];
+                for (uint32_t f : ex->features) z += m.weights[f * classes + c] * x;
+                probs[c] = z;
+                max_logit = max(max_logit, z);
+            }
+            float sum = 0;
+            for (size_t c = 0; c < classes; c++) { probs[c] = exp(probs[c] - max_logit); sum += probs[c]; }
+            for (size_t c = 0; c < classes; c++) {
+                float grad = probs[c] / sum - (static_cast<int>(c) == ex->label ? 1.0f : 0.0f);
+                m.bias[c] -= lr * grad;
+                for (uint32_t f : ex->features) {
+                    float& w = m.weights[f * classes + c];
+                    w -= lr * (grad * x + l2 * w);
+                }
+            }
+        }
+    }
+    return m;
+}
+
+int predictFloat(const FloatModel& m, const Example& ex) {
+    float x = 1.0f / sqrt(static_cast<float>(ex.features.size()));
+    int best = 0;
+    float best_z = -1e30f;
+    for (size_t c = 0; c < m.classes; c++) {
+        float z = m.bias[c];
+        for (uint32_t f : ex.features) z += m.weights[f * m.classes + c] * x;
+        if (z > best_z) { best_z = z; best = static_cast<int>(c); }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    string data_file = argc > 1 ? argv[1] : "intent_queries.tsv";
+    string model_file = argc > 2 ? argv[2] : "intent_model.bin";
+
+    ifstream file(data_file);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open file " << data_file << endl;
+        return 1;
+    }
+
+    IntentFeaturizer featurizer;
+    vector<string> labels;
+    map<string, int> label_ids;
+    vector<Example> examples;
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        size_t tab = line.find('\t');
+        if (tab == string::npos) continue;
+        string label = line.substr(0, tab);
+        if (!label_ids.count(label)) {
+            label_ids[label] = static_cast<int>(labels.size());
+            labels.push_back(label);
+        }
+        Example ex{ label_ids[label], line.substr(tab + 1), {} };
+        ex.features = featurizer.features(ex.text);
+        if (!ex.features.empty()) examples.push_back(ex);
+    }
+    if (examples.empty()) {
+        cerr << "Error: No labeled examples in " << data_file << endl;
+        return 1;
+    }
+    cout << "Loaded " << examples.size() << " examples, " << labels.size() << " intents.\n";
+
+    // 5-fold cross validation.
+    vector<size_t> order(examples.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(42));
+
+    const int folds = 5;
+    size_t correct_float = 0, correct_int8 = 0;
+    size_t classes = labels.size();
+    vector<vector<int>> confusion(classes, vector<int>(classes, 0));
+    for (int fold = 0; fold < folds; fold++) {
+        vector<const Example*> train_set, test_set;
+        for (size_t i = 0; i < order.size(); i++) {
+            (static_cast<int>(i % folds) == fold ? test_set : train_set).push_back(&examples[order[i]]);
+        }
+        FloatModel m = train(train_set, featurizer.buckets(), classes);
+        IntentClassifier q;
+        q.setModel(featurizer, labels, m.weights, m.bias);
+        for (const Example* ex : test_set) {
+            if (predictFloat(m, *ex) == ex->label) correct_float++;
+            int predicted = q.predict(ex->text).label;
+            if (predicted == ex->label) correct_int8++;
+            confusion[ex->label][predicted]++;
+        }
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "\nCross-validated accuracy: float " << 100.0 * correct_float / examples.size()
+        << "%, int8 " << 100.0 * correct_int8 / examples.size() << "%\n\n";
+    cout << left << setw(16) << "intent" << right << setw(10) << "precision" << setw(10) << "recall" << setw(8) << "n" << "\n";
+    for (size_t c = 0; c < classes; c++) {
+        int tp = confusion[c][c], predicted = 0, actual = 0;
+        for (size_t o = 0; o < classes; o++) {
+            predicted += confusion[o][c];
+            actual += confusion[c][o];
+        }
+        cout << left << setw(16) << labels[c] << right
+            << setw(9) << (predicted ? 100.0 * tp / predicted : 0.0) << "%"
+            << setw(9) << (actual ? 100.0 * tp / actual : 0.0) << "%" << setw(8) << actual << "\n";
+    }
+
+    // Final model on all examples.
+    vector<const Example*> all;
+    for (const auto& ex : examples) all.push_back(&ex);
+    FloatModel m = train(all, featurizer.buckets(), classes);
+    IntentClassifier q;
+    q.setModel(featurizer, labels, m.weights, m.bias);
+
+    auto start = chrono::steady_clock::now();
+    size_t runs = 0;
+    for (int rep = 0; rep < 20; rep++) {
+        for (const auto& ex : examples) { q.predict(ex.text); runs++; }
+    }
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / runs;
+    cout << "\nInference: " << setprecision(2) << us << " us per message\n";
+
+    if (!q.save(model_file)) {
+        cerr << "Error: Could not write " << model_file << endl;
+        return 1;
+    }
+    cout << "Saved model to " << model_file << "\n";
+    return 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+// Streaming JSON writer: values are appended to one output string as they
+// are written, with no intermediate document tree. Separators are tracked
+// per open object/array, numbers go through std::to_chars (integral values
+// print without a fraction, NaN and infinity as null).
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class JsonWriter {
+public:
+    JsonWriter& beginObject() { open('{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray() { open('['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    JsonWriter& key(const std::string& name) {
+        separate();
+        appendString(name);
+        out_ += ':';
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter& value(const std::string& s) { separate(); appendString(s); return *this; }
+    JsonWriter& value(const char* s) { return value(std::string(s)); }
+    JsonWriter& value(bool b) { separate(); out_ += b ? "true" : "false"; return *this; }
+    JsonWriter& null() { separate(); out_ += "null"; return *this; }
+
+    template <class T>
+    typename std::enable_if<std::is_arithmetic<T>::value, JsonWriter&>::type value(T v) {
+        separate();
+        appendNumber(static_cast<double>(v));
+        return *this;
+    }
+
+    template <class T>
+    JsonWriter& field(const std::string& name, const T& v) { return key(name).value(v); }
+
+    const std::string& str() const { return out_; }
+
+private:
+    void open(char c) {
+        separate();
+        out_ += c;
+        first_.push_back(true);
+    }
+
+    void close(char c) {
+        out_ += c;
+        first_.pop_back();
+    }
+
+    // Comma before every element but the first; nothing after a key.
+    void separate() {
+        if (after_key_) { after_key_ = false; return; }
+        if (first_.empty()) return;
+        if (!first_.back()) out_ += ',';
+        first_.back() = false;
+    }
+
+    void appendString(const std::string& s) {
+        static const char* hex = "0123456789abcdef";
+        out_ += '"';
+        for (char c : s) {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') { out_ += '\\'; out_ += c; }
+            else if (c == '\n') out_ += "\\n";
+            else if (c == '\t') out_ += "\\t";
+            else if (u < 0x20) { out_ += "\\u00"; out_ += hex[u >> 4]; out_ += hex[u & 15]; }
+            else out_ += c;
+        }
+        out_ += '"';
+    }
+
+    void appendNumber(double v) {
+        if (!std::isfinite(v)) { out_ += "null"; return; }
+        char buf[32];
+        std::to_chars_result r;
+        if (v == std::floor(v) && std::fabs(v) < 1e15) r = std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(v));
+        else r = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, r.ptr);
+    }
+
+    std::string out_;
+    std::vector<bool> first_;
+    bool after_key_ = false;
+};
@@ -0,0 +1,167 @@
+#pragma once
+// Materialized "latest conditions": the newest reading per station
+// (district, state), kept current as readings are loaded or ingested, with
+// the advisory level precomputed and the stations held in best-first,
+// worst-first and name order. Worst/best/all listings and location lookups
+// read the view instead of scanning the history. Worst and best rank only
+// stations with a reading on the newest day, so readings from different
+// days are never compared; all() and match() return every station and
+// callers mark the out-of-date ones. An update changes the
+// entry and all three orderings under one writer lock, so readers (which
+// copy results out under a shared lock) never see a half-applied reading.
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct LatestReading {
+    std::string district;
+    std::string state;
+    std::string date;
+    int day = 0;
+    int api = 0;
+    std::string status;
+    std::string level;          // good / moderate / unhealthy
+    uint64_t seq = 0;           // load order; a later reading of the same day replaces it
+    std::string label;          // "district, state"
+    std::string lower_district;
+    std::string lower_state;
+};
+
+class LatestConditionsView {
+public:
+    static std::string levelFor(int api) { return api <= 50 ? "good" : (api <= 100 ? "moderate" : "unhealthy"); }
+
+    // Newer day replaces, and on the same day the later-loaded reading (a
+    // correction) replaces too: the query engine's tie rule for "latest".
+    void update(const std::string& district, const std::string& state, int api, const std::string& status,
+        const std::string& date, int day) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint64_t seq = next_seq_++;
+        std::string label = district + ", " + state;
+        auto it = stations_.find(label);
+        if (it != stations_.end()) {
+            const LatestReading& current = it->second;
+            if (day < current.day) return;
+            worst_.erase({ -current.api, current.label });
+            best_.erase({ current.api, current.label });
+        }
+        else {
+            by_name_.insert(label);
+            auto named = by_district_.find(district);
+            if (named == by_district_.end() || label < named->second) by_district_[district] = label;
+        }
+        if (day > newest_day_) {
+            newest_day_ = day;
+            newest_date_ = date;
+        }
+
+        LatestReading& r = stations_[label];
+        r.district = district;
+        r.state = state;
+        r.date = date;
+        r.day = day;
+        r.api = api;
+        r.status = status;
+        r.level = levelFor(api);
+        r.seq = seq;
+        r.label = label;
+        r.lower_district = lower(district);
+        r.lower_state = lower(state);
+        worst_.insert({ -api, label });
+        best_.insert({ api, label });
+    }
+
+    std::vector<LatestReading> worst(size_t k) const { return take(worst_, k); }
+    std::vector<LatestReading> best(size_t k) const { return take(best_, k); }
+
+    std::vector<LatestReading> all() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::vector<LatestReading> out;
+        out.reserve(by_name_.size());
+        for (const auto& label : by_name_) out.push_back(stations_.at(label));
+        return out;
+    }
+
+    // Stations whose district or state contains `location` (lowercase),
+    // plus the KL/JB/KK abbreviations, in load order of their readings.
+    // A scan of one entry per station, so nothing is memoized.
+    std::vector<LatestReading> match(const std::string& location) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::vector<std::string> labels;
+        for (const auto& s : stations_) {
+            const LatestReading& r = s.second;
+            if (r.lower_district.find(location) != std::string::npos ||
+                r.lower_state.find(location) != std::string::npos ||
+                (location == "kl" && r.lower_district.find("kuala lumpur") != std::string::npos) ||
+                (location == "jb" && r.lower_district.find("johor bahru") != std::string::npos) ||
+                (location == "kk" && r.lower_district.find("kota kinabalu") != std::string::npos)) {
+                labels.push_back(s.first);
+            }
+        }
+        return inLoadOrder(labels);
+    }
+
+    // Latest reading of one district (any state), for the nearest-station
+    // estimate; false when the district has none.
+    bool find(const std::string& district, LatestReading& out) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = by_district_.find(district);
+        if (it == by_district_.end()) return false;
+        out = stations_.at(it->second);
+        return true;
+    }
+
+    // Date of the newest reading of any station ("" when empty).
+    std::string newestDate() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return newest_date_;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return stations_.size();
+    }
+    bool empty() const { return size() == 0; }
+
+private:
+    using Order = std::set<std::pair<int, std::string>>;   // (api or -api, label)
+
+    static std::string lower(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    std::vector<LatestReading> take(const Order& order, size_t k) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::vector<LatestReading> out;
+        for (auto it = order.begin(); it != order.end() && out.size() < k; ++it) {
+            const LatestReading& r = stations_.at(it->second);
+            if (r.day == newest_day_) out.push_back(r);
+        }
+        return out;
+    }
+
+    std::vector<LatestReading> inLoadOrder(const std::vector<std::string>& labels) const {
+        std::vector<LatestReading> out;
+        for (const auto& label : labels) out.push_back(stations_.at(label));
+        std::sort(out.begin(), out.end(), [](const LatestReading& a, const LatestReading& b) { return a.seq < b.seq; });
+        return out;
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, LatestReading> stations_;   // by label
+    Order worst_, best_;
+    std::set<std::string> by_name_;
+    std::unordered_map<std::string, std::string> by_district_;   // district -> first label by name
+    int newest_day_ = INT_MIN;
+    std::string newest_date_;
+    uint64_t next_seq_ = 0;
+};
@@ -0,0 +1,104 @@
+#pragma once
+// Per-subsystem memory accounting. Containers that should be counted use
+// TrackingAllocator<T, subsystem>, which adds every allocation to a global
+// ledger (current and peak bytes per subsystem). The ledger is lock-free, so
+// containers used by query worker threads can be tracked as well.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+enum class MemSubsystem { RECORDS, STRINGS, INDEXES, CACHES, QUERY, COUNT };
+
+class MemoryLedger {
+public:
+    static const size_t kSubsystems = static_cast<size_t>(MemSubsystem::COUNT);
+
+    static const char* name(MemSubsystem s) {
+        static const char* names[kSubsystems] = { "records", "strings", "indexes", "caches", "query" };
+        return names[static_cast<size_t>(s)];
+    }
+
+    static void add(MemSubsystem s, size_t bytes) {
+        Counter& c = counter(s);
+        int64_t now = c.current.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+        int64_t peak = c.peak.load(std::memory_order_relaxed);
+        while (now > peak && !c.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    }
+
+    static void sub(MemSubsystem s, size_t bytes) {
+        counter(s).current.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    }
+
+    static size_t current(MemSubsystem s) {
+        int64_t v = counter(s).current.load(std::memory_order_relaxed);
+        return v > 0 ? static_cast<size_t>(v) : 0;
+    }
+
+    static size_t peak(MemSubsystem s) {
+        int64_t v = counter(s).peak.load(std::memory_order_relaxed);
+        return v > 0 ? static_cast<size_t>(v) : 0;
+    }
+
+    static size_t total() {
+        size_t sum = 0;
+        for (size_t i = 0; i < kSubsystems; i++) sum += current(static_cast<MemSubsystem>(i));
+        return sum;
+    }
+
+private:
+    struct Counter {
+        std::atomic<int64_t> current{ 0 };
+        std::atomic<int64_t> peak{ 0 };
+    };
+
+    static Counter& counter(MemSubsystem s) {
+        static Counter counters[kSubsystems];
+        return counters[static_cast<size_t>(s)];
+    }
+};
+
+template <class T, MemSubsystem S>
+struct TrackingAllocator {
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    template <class U>
+    struct rebind { using other = TrackingAllocator<U, S>; };
+
+    TrackingAllocator() = default;
+    template <class U>
+    TrackingAllocator(const TrackingAllocator<U, S>&) {}
+
+    T* allocate(size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        MemoryLedger::add(S, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) {
+        MemoryLedger::sub(S, n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <class U>
+    bool operator==(const TrackingAllocator<U, S>&) const { return true; }
+    template <class U>
+    bool operator!=(const TrackingAllocator<U, S>&) const { return false; }
+};
+
+template <class T, MemSubsystem S>
+using TrackedVector = std::vector<T, TrackingAllocator<T, S>>;
+
+template <MemSubsystem S>
+using TrackedString = std::basic_string<char, std::char_traits<char>, TrackingAllocator<char, S>>;
+
+struct TrackedStringHash {
+    template <class String>
+    size_t operator()(const String& s) const { return std::hash<std::string_view>()(std::string_view(s.data(), s.size())); }
+};
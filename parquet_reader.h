@@ -0,0 +1,674 @@
+#pragma once
+// Minimal self-contained Parquet reader for air quality exports.
+// Supports flat schemas, PLAIN / RLE / dictionary encoded pages (v1 and v2),
+// UNCOMPRESSED and SNAPPY codecs. Only the projected columns are read from
+// disk, and row groups whose min/max statistics fall outside the filter can
+// be skipped without decoding.
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Date range pushed down into the load. Empty strings mean "no bound".
+struct ParquetFilter {
+    std::string date_from;   // inclusive, YYYY-MM-DD
+    std::string date_to;     // inclusive, YYYY-MM-DD
+};
+
+class ParquetReader {
+public:
+    enum PhysicalType { BOOLEAN = 0, INT32 = 1, INT64 = 2, INT96 = 3, FLOAT = 4, DOUBLE = 5, BYTE_ARRAY = 6, FIXED_LEN_BYTE_ARRAY = 7 };
+    enum Codec { UNCOMPRESSED = 0, SNAPPY = 1, GZIP = 2, LZO = 3, BROTLI = 4, LZ4 = 5, ZSTD = 6 };
+
+    struct Statistics {
+        std::string min_value, max_value;
+        bool has_min_max = false;
+    };
+
+    struct ColumnChunk {
+        std::string name;
+        int type = -1;
+        int codec = UNCOMPRESSED;
+        int64_t num_values = 0;
+        int64_t data_page_offset = -1;
+        int64_t dictionary_page_offset = -1;
+        int64_t total_compressed_size = 0;
+        Statistics stats;
+    };
+
+    struct RowGroup {
+        int64_t num_rows = 0;
+        std::vector<ColumnChunk> columns;
+    };
+
+    struct SchemaColumn {
+        std::string name;
+        int type = -1;
+        int repetition = 0;      // 0 required, 1 optional, 2 repeated
+        int converted_type = -1;
+    };
+
+    // One decoded column of a row group. Exactly one of the value vectors is
+    // populated depending on the physical type; `valid` marks non-null rows.
+    struct ColumnValues {
+        std::vector<std::string> strs;
+        std::vector<int64_t> ints;
+        std::vector<double> dbls;
+        std::vector<uint8_t> valid;
+    };
+
+    bool open(const std::string& filename) {
+        file_.open(filename, std::ios::binary);
+        if (!file_.is_open()) return fail("could not open " + filename);
+
+        file_.seekg(0, std::ios::end);
+        int64_t size = file_.tellg();
+        if (size < 12) return fail("file too small to be parquet");
+
+        char tail[8];
+        file_.seekg(size - 8);
+        file_.read(tail, 8);
+        if (memcmp(tail + 4, "PAR1", 4) != 0) return fail("missing PAR1 footer magic");
+
+        uint32_t footer_len;
+        memcpy(&footer_len, tail, 4);
+        if (footer_len + 12 > size) return fail("corrupt footer length");
+        file_size_ = size;
+
+        std::string footer(footer_len, '\0');
+        file_.seekg(size - 8 - footer_len);
+        file_.read(&footer[0], footer_len);
+
+        ThriftReader tr(reinterpret_cast<const uint8_t*>(footer.data()), footer.size());
+        if (!readFileMetaData(tr) || tr.failed) return fail("could not parse file metadata");
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+    int64_t numRows() const { return num_rows_; }
+    const std::vector<RowGroup>& rowGroups() const { return row_groups_; }
+    const std::vector<SchemaColumn>& schema() const { return schema_; }
+
+    // Case-insensitive column lookup; returns -1 when no alias matches.
+    int findColumn(const std::vector<std::string>& aliases) const {
+        for (const auto& alias : aliases) {
+            for (size_t i = 0; i < schema_.size(); i++) {
+                if (equalsIgnoreCase(schema_[i].name, alias)) return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // Decode one column chunk of a row group, reading only its byte range.
+    bool readColumn(size_t row_group, int column, ColumnValues& out) {
+        const RowGroup& rg = row_groups_[row_group];
+        const ColumnChunk& cc = rg.columns[column];
+        const SchemaColumn& sc = schema_[column];
+
+        int64_t start = cc.data_page_offset;
+        if (cc.dictionary_page_offset > 0 && cc.dictionary_page_offset < start) start = cc.dictionary_page_offset;
+        // Offsets and sizes come from the file: the chunk must lie inside it.
+        if (start < 0 || cc.total_compressed_size <= 0 || cc.total_compressed_size > file_size_ - start) {
+            return fail("column chunk " + sc.name + " lies outside the file");
+        }
+
+        std::string chunk(static_cast<size_t>(cc.total_compressed_size), '\0');
+        file_.seekg(start);
+        file_.read(&chunk[0], chunk.size());
+        if (!file_) return fail("short read in column " + sc.name);
+
+        out = ColumnValues();
+        out.valid.reserve(static_cast<size_t>(std::max<int64_t>(0, std::min<int64_t>(rg.num_rows, cc.num_values))));
+
+        std::vector<std::string> dict_strs;
+        std::vector<int64_t> dict_ints;
+        std::vector<double> dict_dbls;
+
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(chunk.data());
+        const uint8_t* end = p + chunk.size();
+        int64_t values_read = 0;
+        std::string page_buf;
+
+        while (p < end && values_read < cc.num_values) {
+            ThriftReader tr(p, end - p);
+            PageHeader ph;
+            if (!readPageHeader(tr, ph) || tr.failed) return fail("bad page header in " + sc.name);
+            p += tr.pos;
+            if (ph.compressed_size > end - p || ph.uncompressed_size < 0 || ph.num_values < 0) {
+                return fail("page overruns column chunk " + sc.name);
+            }
+
+            const uint8_t* page = p;
+            p += ph.compressed_size;
+
+            if (ph.type == 2) {  // DICTIONARY_PAGE
+                if (!decompress(cc.codec, page, ph.compressed_size, ph.uncompressed_size, page_buf)) return false;
+                const uint8_t* d = reinterpret_cast<const uint8_t*>(page_buf.data());
+                const uint8_t* dend = d + page_buf.size();
+                if (!decodePlain(sc.type, d, dend, ph.num_values, dict_strs, dict_ints, dict_dbls)) return fail("bad dictionary page in " + sc.name);
+                continue;
+            }
+            if (ph.type != 0 && ph.type != 3) continue;  // index pages etc.
+
+            const uint8_t* values;
+            const uint8_t* vend;
+            std::vector<uint8_t> defs;
+            int max_def = sc.repetition == 1 ? 1 : 0;
+
+            if (ph.type == 0) {  // DATA_PAGE (v1): whole page compressed
+                if (!decompress(cc.codec, page, ph.compressed_size, ph.uncompressed_size, page_buf)) return false;
+                values = reinterpret_cast<const uint8_t*>(page_buf.data());
+                vend = values + page_buf.size();
+                if (max_def > 0) {
+                    if (vend - values < 4) return fail("truncated definition levels in " + sc.name);
+                    uint32_t len;
+                    memcpy(&len, values, 4);
+                    values += 4;
+                    if (len > static_cast<uint64_t>(vend - values)) return fail("truncated definition levels in " + sc.name);
+                    if (!decodeRleHybrid(values, values + len, 1, ph.num_values, defs)) return fail("bad definition levels in " + sc.name);
+                    values += len;
+                }
+            }
+            else {  // DATA_PAGE_V2: levels stored uncompressed ahead of values
+                if (ph.rep_levels_len < 0 || ph.def_levels_len < 0 ||
+                    static_cast<int64_t>(ph.rep_levels_len) + ph.def_levels_len > ph.compressed_size ||
+                    static_cast<int64_t>(ph.rep_levels_len) + ph.def_levels_len > ph.uncompressed_size) {
+                    return fail("level lengths overrun page in " + sc.name);
+                }
+                const uint8_t* levels = page + ph.rep_levels_len;
+                if (max_def > 0 && !decodeRleHybrid(levels, levels + ph.def_levels_len, 1, ph.num_values, defs)) return fail("bad definition levels in " + sc.name);
+                int32_t level_bytes = ph.rep_levels_len + ph.def_levels_len;
+                if (ph.is_compressed && cc.codec != UNCOMPRESSED) {
+                    if (!decompress(cc.codec, page + level_bytes, ph.compressed_size - level_bytes,
+                        ph.uncompressed_size - level_bytes, page_buf)) return false;
+                    values = reinterpret_cast<const uint8_t*>(page_buf.data());
+                    vend = values + page_buf.size();
+                }
+                else {
+                    values = page + level_bytes;
+                    vend = page + ph.compressed_size;
+                }
+            }
+
+            int32_t non_null = 0;
+            if (defs.empty()) non_null = ph.num_values;
+            else for (uint8_t d : defs) non_null += d;
+
+            std::vector<std::string> page_strs;
+            std::vector<int64_t> page_ints;
+            std::vector<double> page_dbls;
+
+            if (ph.encoding == 0) {  // PLAIN
+                if (!decodePlain(sc.type, values, vend, non_null, page_strs, page_ints, page_dbls)) return fail("bad plain page in " + sc.name);
+            }
+            else if (ph.encoding == 2 || ph.encoding == 8) {  // PLAIN_DICTIONARY / RLE_DICTIONARY
+                if (values >= vend) return fail("empty dictionary page in " + sc.name);
+                int bit_width = *values++;
+                if (bit_width > 32) return fail("bad dictionary index width in " + sc.name);
+                std::vector<uint32_t> idx;
+                if (!decodeRleHybrid(values, vend, bit_width, non_null, idx)) return fail("bad dictionary indices in " + sc.name);
+                for (uint32_t i : idx) {
+                    if (!dict_strs.empty() && i < dict_strs.size()) page_strs.push_back(dict_strs[i]);
+                    else if (!dict_ints.empty() && i < dict_ints.size()) page_ints.push_back(dict_ints[i]);
+                    else if (!dict_dbls.empty() && i < dict_dbls.size()) page_dbls.push_back(dict_dbls[i]);
+                    else return fail("dictionary index out of range in " + sc.name);
+                }
+            }
+            else {
+                return fail("unsupported encoding " + std::to_string(ph.encoding) + " in " + sc.name);
+            }
+
+            // Spread the non-null values over the page's rows.
+            size_t vi = 0;
+            for (int32_t r = 0; r < ph.num_values; r++) {
+                bool present = defs.empty() || defs[r] == max_def;
+                out.valid.push_back(present ? 1 : 0);
+                if (sc.type == BYTE_ARRAY || sc.type == FIXED_LEN_BYTE_ARRAY) out.strs.push_back(present ? std::move(page_strs[vi]) : std::string());
+                else if (sc.type == FLOAT || sc.type == DOUBLE) out.dbls.push_back(present ? page_dbls[vi] : 0.0);
+                else out.ints.push_back(present ? page_ints[vi] : 0);
+                if (present) vi++;
+            }
+            values_read += ph.num_values;
+        }
+        if (values_read < cc.num_values) return fail("column chunk " + sc.name + " ends before its last value");
+        return true;
+    }
+
+    // Convert an INT32 DATE (days since 1970-01-01) to YYYY-MM-DD; empty
+    // when the day is outside years 0..9999 or the conversion fails.
+    static std::string formatDate(int64_t days) {
+        if (days < -719528 || days > 2932896) return std::string();
+        time_t t = static_cast<time_t>(days) * 86400;
+        struct tm tm_utc;
+#ifdef _WIN32
+        if (gmtime_s(&tm_utc, &t) != 0) return std::string();
+#else
+        if (!gmtime_r(&t, &tm_utc)) return std::string();
+#endif
+        char buf[16];
+        if (strftime(buf, sizeof(buf), "%Y-%m-%d", &tm_utc) == 0) return std::string();
+        return buf;
+    }
+
+    static std::string codecName(int codec) {
+        static const char* names[] = { "UNCOMPRESSED", "SNAPPY", "GZIP", "LZO", "BROTLI", "LZ4", "ZSTD", "LZ4_RAW" };
+        return codec >= 0 && codec < 8 ? names[codec] : "UNKNOWN";
+    }
+
+private:
+    // --- Thrift compact protocol -------------------------------------------
+    struct ThriftReader {
+        const uint8_t* data;
+        size_t size;
+        size_t pos = 0;
+        bool failed = false;
+
+        ThriftReader(const uint8_t* d, size_t s) : data(d), size(s) {}
+
+        uint8_t byte() {
+            if (pos >= size) { failed = true; return 0; }
+            return data[pos++];
+        }
+        uint64_t varint() {
+            uint64_t result = 0;
+            int shift = 0;
+            while (!failed) {
+                uint8_t b = byte();
+                result |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (!(b & 0x80)) break;
+                shift += 7;
+                if (shift > 63) failed = true;
+            }
+            return result;
+        }
+        int64_t zigzag() {
+            uint64_t v = varint();
+            return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+        }
+        std::string binary() {
+            uint64_t len = varint();
+            if (len > size - pos) { failed = true; return std::string(); }
+            std::string s(reinterpret_cast<const char*>(data + pos), len);
+            pos += len;
+            return s;
+        }
+        // Reads a field header; returns false at STOP. `last_id` tracks deltas.
+        bool field(int& type, int& id, int& last_id) {
+            uint8_t b = byte();
+            if (failed || b == 0) return false;
+            type = b & 0x0f;
+            int delta = b >> 4;
+            id = delta ? last_id + delta : static_cast<int>(zigzag());
+            last_id = id;
+            return true;
+        }
+        void listHeader(int& elem_type, uint64_t& count) {
+            uint8_t b = byte();
+            elem_type = b & 0x0f;
+            count = b >> 4;
+            if (count == 15) count = varint();
+        }
+        bool boolValue(int type) { return type == 1; }
+        void skip(int type) {
+            switch (type) {
+            case 1: case 2: break;                       // bool stored in type
+            case 3: byte(); break;                       // i8
+            case 4: case 5: case 6: varint(); break;     // i16/i32/i64
+            case 7: pos += 8; if (pos > size) failed = true; break;
+            case 8: binary(); break;
+            case 9: case 10: {
+                int et; uint64_t n;
+                listHeader(et, n);
+                for (uint64_t i = 0; i < n && !failed; i++) {
+                    if (et == 1 || et == 2) byte();
+                    else skip(et);
+                }
+                break;
+            }
+            case 11: {
+                uint64_t n = varint();
+                if (n == 0) break;
+                uint8_t kv = byte();
+                for (uint64_t i = 0; i < n && !failed; i++) { skip(kv >> 4); skip(kv & 0x0f); }
+                break;
+            }
+            case 12: {
+                int t, id, last = 0;
+                while (!failed && field(t, id, last)) skip(t);
+                break;
+            }
+            default: failed = true;
+            }
+        }
+    };
+
+    struct PageHeader {
+        int type = -1;
+        int32_t uncompressed_size = 0;
+        int32_t compressed_size = 0;
+        int32_t num_values = 0;
+        int encoding = 0;
+        int32_t def_levels_len = 0;
+        int32_t rep_levels_len = 0;
+        bool is_compressed = true;
+    };
+
+    bool readFileMetaData(ThriftReader& tr) {
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 2 && t == 9) {
+                int et; uint64_t n;
+                tr.listHeader(et, n);
+                for (uint64_t i = 0; i < n && !tr.failed; i++) {
+                    SchemaColumn sc;
+                    int num_children = 0;
+                    readSchemaElement(tr, sc, num_children);
+                    // Element 0 is the root group; nested groups are not supported.
+                    if (i == 0) continue;
+                    if (num_children > 0) return fail("nested schemas are not supported");
+                    schema_.push_back(sc);
+                }
+            }
+            else if (id == 3 && t == 6) num_rows_ = tr.zigzag();
+            else if (id == 4 && t == 9) {
+                int et; uint64_t n;
+                tr.listHeader(et, n);
+                for (uint64_t i = 0; i < n && !tr.failed; i++) {
+                    RowGroup rg;
+                    readRowGroup(tr, rg);
+                    row_groups_.push_back(rg);
+                }
+            }
+            else tr.skip(t);
+        }
+        for (auto& rg : row_groups_) {
+            if (rg.columns.size() != schema_.size()) return fail("row group column count mismatch");
+        }
+        return true;
+    }
+
+    void readSchemaElement(ThriftReader& tr, SchemaColumn& sc, int& num_children) {
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 1 && t == 5) sc.type = static_cast<int>(tr.zigzag());
+            else if (id == 3 && t == 5) sc.repetition = static_cast<int>(tr.zigzag());
+            else if (id == 4 && t == 8) sc.name = tr.binary();
+            else if (id == 5 && t == 5) num_children = static_cast<int>(tr.zigzag());
+            else if (id == 6 && t == 5) sc.converted_type = static_cast<int>(tr.zigzag());
+            else tr.skip(t);
+        }
+    }
+
+    void readRowGroup(ThriftReader& tr, RowGroup& rg) {
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 1 && t == 9) {
+                int et; uint64_t n;
+                tr.listHeader(et, n);
+                for (uint64_t i = 0; i < n && !tr.failed; i++) {
+                    ColumnChunk cc;
+                    int ct, cid, clast = 0;
+                    while (tr.field(ct, cid, clast)) {
+                        if (cid == 3 && ct == 12) readColumnMetaData(tr, cc);
+                        else tr.skip(ct);
+                    }
+                    rg.columns.push_back(cc);
+                }
+            }
+            else if (id == 3 && t == 6) rg.num_rows = tr.zigzag();
+            else tr.skip(t);
+        }
+    }
+
+    void readColumnMetaData(ThriftReader& tr, ColumnChunk& cc) {
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 1 && t == 5) cc.type = static_cast<int>(tr.zigzag());
+            else if (id == 3 && t == 9) {
+                int et; uint64_t n;
+                tr.listHeader(et, n);
+                for (uint64_t i = 0; i < n && !tr.failed; i++) {
+                    if (i) cc.name += ".";
+                    cc.name += tr.binary();
+                }
+            }
+            else if (id == 4 && t == 5) cc.codec = static_cast<int>(tr.zigzag());
+            else if (id == 5 && t == 6) cc.num_values = tr.zigzag();
+            else if (id == 7 && t == 6) cc.total_compressed_size = tr.zigzag();
+            else if (id == 9 && t == 6) cc.data_page_offset = tr.zigzag();
+            else if (id == 11 && t == 6) cc.dictionary_page_offset = tr.zigzag();
+            else if (id == 12 && t == 12) readStatistics(tr, cc.stats);
+            else tr.skip(t);
+        }
+    }
+
+    void readStatistics(ThriftReader& tr, Statistics& st) {
+        std::string legacy_min, legacy_max;
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 1 && t == 8) legacy_max = tr.binary();
+            else if (id == 2 && t == 8) legacy_min = tr.binary();
+            else if (id == 5 && t == 8) { st.max_value = tr.binary(); st.has_min_max = true; }
+            else if (id == 6 && t == 8) { st.min_value = tr.binary(); st.has_min_max = true; }
+            else tr.skip(t);
+        }
+        if (!st.has_min_max && (!legacy_min.empty() || !legacy_max.empty())) {
+            st.min_value = legacy_min;
+            st.max_value = legacy_max;
+            st.has_min_max = true;
+        }
+    }
+
+    bool readPageHeader(ThriftReader& tr, PageHeader& ph) {
+        int t, id, last = 0;
+        while (tr.field(t, id, last)) {
+            if (id == 1 && t == 5) ph.type = static_cast<int>(tr.zigzag());
+            else if (id == 2 && t == 5) ph.uncompressed_size = static_cast<int32_t>(tr.zigzag());
+            else if (id == 3 && t == 5) ph.compressed_size = static_cast<int32_t>(tr.zigzag());
+            else if ((id == 5 || id == 7 || id == 8) && t == 12) {
+                int st, sid, slast = 0;
+                while (tr.field(st, sid, slast)) {
+                    if (sid == 1 && st == 5) ph.num_values = static_cast<int32_t>(tr.zigzag());
+                    else if (id == 5 && sid == 2 && st == 5) ph.encoding = static_cast<int>(tr.zigzag());
+                    else if (id == 7 && sid == 2 && st == 5) ph.encoding = static_cast<int>(tr.zigzag());
+                    else if (id == 8 && sid == 4 && st == 5) ph.encoding = static_cast<int>(tr.zigzag());
+                    else if (id == 8 && sid == 5 && st == 5) ph.def_levels_len = static_cast<int32_t>(tr.zigzag());
+                    else if (id == 8 && sid == 6 && st == 5) ph.rep_levels_len = static_cast<int32_t>(tr.zigzag());
+                    else if (id == 8 && sid == 7 && (st == 1 || st == 2)) ph.is_compressed = tr.boolValue(st);
+                    else tr.skip(st);
+                }
+            }
+            else tr.skip(t);
+        }
+        return ph.type >= 0 && ph.compressed_size >= 0;
+    }
+
+    // --- Page decoding ------------------------------------------------------
+    static bool decodePlain(int type, const uint8_t* p, const uint8_t* end, int64_t count,
+        std::vector<std::string>& strs, std::vector<int64_t>& ints, std::vector<double>& dbls) {
+        for (int64_t i = 0; i < count; i++) {
+            switch (type) {
+            case BOOLEAN: {
+                if (p + i / 8 >= end) return false;
+                ints.push_back((p[i / 8] >> (i % 8)) & 1);
+                break;
+            }
+            case INT32: {
+                if (end - p < 4) return false;
+                int32_t v; memcpy(&v, p, 4); p += 4;
+                ints.push_back(v);
+                break;
+            }
+            case INT64: {
+                if (end - p < 8) return false;
+                int64_t v; memcpy(&v, p, 8); p += 8;
+                ints.push_back(v);
+                break;
+            }
+            case FLOAT: {
+                if (end - p < 4) return false;
+                float v; memcpy(&v, p, 4); p += 4;
+                dbls.push_back(v);
+                break;
+            }
+            case DOUBLE: {
+                if (end - p < 8) return false;
+                double v; memcpy(&v, p, 8); p += 8;
+                dbls.push_back(v);
+                break;
+            }
+            case BYTE_ARRAY: {
+                if (end - p < 4) return false;
+                uint32_t len; memcpy(&len, p, 4); p += 4;
+                if (static_cast<uint32_t>(end - p) < len) return false;
+                strs.emplace_back(reinterpret_cast<const char*>(p), len);
+                p += len;
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    static bool decodeRleHybrid(const uint8_t* p, const uint8_t* end, int bit_width, int64_t count, std::vector<T>& out) {
+        int byte_width = (bit_width + 7) / 8;
+        size_t target = out.size() + count;
+        while (out.size() < target) {
+            if (p >= end) return false;
+            uint64_t header = 0;
+            int shift = 0;
+            while (true) {
+                if (p >= end) return false;
+                uint8_t b = *p++;
+                header |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (!(b & 0x80)) break;
+                shift += 7;
+            }
+            if (header & 1) {  // bit-packed run of groups of 8
+                uint64_t values = (header >> 1) * 8;
+                uint64_t bytes = (header >> 1) * bit_width;
+                if (static_cast<uint64_t>(end - p) < bytes) return false;
+                for (uint64_t i = 0; i < values && out.size() < target; i++) {
+                    uint64_t bit = i * bit_width;
+                    uint64_t v = 0;
+                    for (int b = 0; b < bit_width; b++, bit++) {
+                        v |= static_cast<uint64_t>((p[bit / 8] >> (bit % 8)) & 1) << b;
+                    }
+                    out.push_back(static_cast<T>(v));
+                }
+                p += bytes;
+            }
+            else {  // repeated value
+                uint64_t run = header >> 1;
+                if (end - p < byte_width) return false;
+                uint64_t v = 0;
+                for (int b = 0; b < byte_width; b++) v |= static_cast<uint64_t>(p[b]) << (8 * b);
+                p += byte_width;
+                for (uint64_t i = 0; i < run && out.size() < target; i++) out.push_back(static_cast<T>(v));
+            }
+        }
+        return true;
+    }
+
+    bool decompress(int codec, const uint8_t* src, int32_t src_len, int32_t dst_len, std::string& dst) {
+        if (codec == UNCOMPRESSED) {
+            dst.assign(reinterpret_cast<const char*>(src), src_len);
+            return true;
+        }
+        if (codec == SNAPPY) {
+            if (!snappyDecompress(src, src_len, dst_len, dst) || static_cast<int32_t>(dst.size()) != dst_len) {
+                return fail("corrupt snappy page");
+            }
+            return true;
+        }
+        return fail("unsupported compression codec " + codecName(codec) + " (re-export with SNAPPY or no compression)");
+    }
+
+    // `max_out` is the page's declared size; the stream's own length prefix
+    // must not exceed it, or what `len` bytes of Snappy can expand to.
+    static bool snappyDecompress(const uint8_t* p, size_t len, size_t max_out, std::string& out) {
+        const uint8_t* end = p + len;
+        uint64_t expected = 0;
+        int shift = 0;
+        while (true) {
+            if (p >= end) return false;
+            uint8_t b = *p++;
+            expected |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+        if (expected > max_out || expected > 32 * static_cast<uint64_t>(len)) return false;
+        out.clear();
+        out.reserve(expected);
+        while (p < end) {
+            uint8_t tag = *p++;
+            uint32_t length, offset;
+            switch (tag & 3) {
+            case 0: {  // literal
+                length = (tag >> 2) + 1;
+                if (length > 60) {
+                    int extra = length - 60;
+                    if (end - p < extra) return false;
+                    length = 0;
+                    for (int i = 0; i < extra; i++) length |= static_cast<uint32_t>(p[i]) << (8 * i);
+                    length += 1;
+                    p += extra;
+                }
+                if (static_cast<uint32_t>(end - p) < length || length > expected - out.size()) return false;
+                out.append(reinterpret_cast<const char*>(p), length);
+                p += length;
+                continue;
+            }
+            case 1:
+                if (p >= end) return false;
+                length = ((tag >> 2) & 7) + 4;
+                offset = ((tag >> 5) << 8) | *p++;
+                break;
+            case 2:
+                if (end - p < 2) return false;
+                length = (tag >> 2) + 1;
+                offset = p[0] | (p[1] << 8);
+                p += 2;
+                break;
+            default:
+                if (end - p < 4) return false;
+                length = (tag >> 2) + 1;
+                memcpy(&offset, p, 4);
+                p += 4;
+                break;
+            }
+            if (offset == 0 || offset > out.size() || length > expected - out.size()) return false;
+            size_t from = out.size() - offset;
+            for (uint32_t i = 0; i < length; i++) out.push_back(out[from + i]);
+        }
+        return out.size() == expected;
+    }
+
+    static bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+        }
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        if (error_.empty()) error_ = message;
+        return false;
+    }
+
+    std::ifstream file_;
+    int64_t file_size_ = 0;
+    std::string error_;
+    int64_t num_rows_ = 0;
+    std::vector<SchemaColumn> schema_;
+    std::vector<RowGroup> row_groups_;
+};
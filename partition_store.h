@@ -0,0 +1,104 @@
+#pragma once
+// Month-partitioned storage for API readings. A partition directory holds one
+// text file per month (same "district,state,api,status,date" lines as the
+// main data file) and a manifest describing each partition's date range,
+// row count and districts (with their states), so queries can decide which
+// months to load without opening the data files.
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct PartitionInfo {
+    std::string month;        // YYYY-MM
+    std::string file;         // relative to the partition directory
+    std::string first_date;
+    std::string last_date;
+    size_t rows = 0;
+    std::vector<std::string> districts;
+    std::vector<std::string> states;    // state of each district; empty in older manifests
+
+    // Runtime state, not persisted.
+    bool resident = false;
+    bool sketched = false;    // readings already folded into the quantile sketches
+    size_t bytes = 0;
+    uint64_t last_used = 0;
+};
+
+class PartitionManifest {
+public:
+    static std::string manifestPath(const std::string& dir) { return dir + "/manifest.txt"; }
+
+    static bool exists(const std::string& dir) {
+        std::ifstream f(manifestPath(dir));
+        return f.is_open();
+    }
+
+    // Manifest lines: month,file,first_date,last_date,rows,district;...,state;...
+    bool load(const std::string& dir) {
+        dir_ = dir;
+        partitions_.clear();
+        std::ifstream in(manifestPath(dir));
+        if (!in.is_open()) return false;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::stringstream ls(line);
+            PartitionInfo p;
+            std::string rows, districts, states;
+            if (!std::getline(ls, p.month, ',') || !std::getline(ls, p.file, ',') ||
+                !std::getline(ls, p.first_date, ',') || !std::getline(ls, p.last_date, ',') ||
+                !std::getline(ls, rows, ',')) continue;
+            std::getline(ls, districts, ',');
+            std::getline(ls, states);
+            try { p.rows = std::stoul(rows); }
+            catch (...) { continue; }
+            std::stringstream ds(districts);
+            std::string d;
+            while (std::getline(ds, d, ';')) if (!d.empty()) p.districts.push_back(d);
+            std::stringstream ss(states);
+            while (std::getline(ss, d, ';')) p.states.push_back(d);
+            if (p.states.size() != p.districts.size()) p.states.clear();
+            partitions_.push_back(p);
+        }
+        std::sort(partitions_.begin(), partitions_.end(),
+            [](const PartitionInfo& a, const PartitionInfo& b) { return a.month < b.month; });
+        return true;
+    }
+
+    bool save(const std::string& dir) const {
+        std::ofstream out(manifestPath(dir));
+        if (!out.is_open()) return false;
+        out << "# month,file,first_date,last_date,rows,districts,states\n";
+        for (const auto& p : partitions_) {
+            out << p.month << "," << p.file << "," << p.first_date << "," << p.last_date << "," << p.rows << ",";
+            for (size_t i = 0; i < p.districts.size(); i++) out << (i ? ";" : "") << p.districts[i];
+            out << ",";
+            for (size_t i = 0; i < p.states.size(); i++) out << (i ? ";" : "") << p.states[i];
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Partitions overlapping [from, to] (inclusive, empty = unbounded).
+    std::vector<size_t> overlapping(const std::string& from, const std::string& to) const {
+        std::vector<size_t> out;
+        for (size_t i = 0; i < partitions_.size(); i++) {
+            if (!from.empty() && partitions_[i].last_date < from) continue;
+            if (!to.empty() && partitions_[i].first_date > to) continue;
+            out.push_back(i);
+        }
+        return out;
+    }
+
+    std::string filePath(size_t i) const { return dir_ + "/" + partitions_[i].file; }
+    std::vector<PartitionInfo>& partitions() { return partitions_; }
+    const std::vector<PartitionInfo>& partitions() const { return partitions_; }
+
+private:
+    std::string dir_;
+    std::vector<PartitionInfo> partitions_;
+};
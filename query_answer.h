@@ -0,0 +1,111 @@
+#pragma once
+// Typed answers. Data handlers fill a QueryAnswer (records, aggregates,
+// series, advisories) instead of formatting text; the chat text renderer
+// and writeAnswerJson are two consumers of the same answer, so the n8n
+// workflow can take the numbers directly instead of parsing chat text.
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json_writer.h"
+
+struct AnswerRecord {
+    std::string district;
+    std::string state;
+    std::string date;     // empty for per-area aggregates (rankings)
+    double api = 0;
+    std::string status;
+};
+
+struct AnswerPoint {
+    std::string date;
+    double value = 0;
+    double error = NAN;   // forecast spread; NAN when not applicable
+};
+
+struct AnswerSeries {
+    std::string name;
+    std::vector<AnswerPoint> points;
+};
+
+struct AnswerAdvisory {
+    std::string district;
+    std::string state;
+    std::string date;     // of the reading; older than the answer's period when the station has no newer one
+    double api = 0;
+    std::string status;
+    std::string level;    // good / moderate / unhealthy
+    std::string advice;
+};
+
+struct QueryAnswer {
+    std::string intent;   // selects the text renderer; "text" for free-text answers
+    std::string subject;  // area, state or date the answer is about
+    std::string period;
+    std::vector<AnswerRecord> records;
+    std::vector<std::pair<std::string, double>> aggregates;
+    std::vector<AnswerSeries> series;
+    std::vector<AnswerAdvisory> advisories;
+    std::string text;
+
+    void aggregate(const std::string& name, double value) { aggregates.push_back({ name, value }); }
+
+    // NAN when the aggregate is absent.
+    double get(const std::string& name) const {
+        for (const auto& a : aggregates) if (a.first == name) return a.second;
+        return NAN;
+    }
+};
+
+// {"intent":...,"records":[...],"aggregates":{...},"series":[...],"advisories":[...]}
+// with empty sections and empty fields left out.
+inline void writeAnswerJson(const QueryAnswer& answer, JsonWriter& json) {
+    json.beginObject();
+    json.field("intent", answer.intent);
+    if (!answer.subject.empty()) json.field("subject", answer.subject);
+    if (!answer.period.empty()) json.field("period", answer.period);
+
+    if (!answer.records.empty()) {
+        json.key("records").beginArray();
+        for (const auto& r : answer.records) {
+            json.beginObject().field("district", r.district).field("state", r.state);
+            if (!r.date.empty()) json.field("date", r.date);
+            json.field("api", r.api);
+            if (!r.status.empty()) json.field("status", r.status);
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    if (!answer.aggregates.empty()) {
+        json.key("aggregates").beginObject();
+        for (const auto& a : answer.aggregates) json.field(a.first, a.second);
+        json.endObject();
+    }
+
+    if (!answer.series.empty()) {
+        json.key("series").beginArray();
+        for (const auto& s : answer.series) {
+            json.beginObject().field("name", s.name).key("points").beginArray();
+            for (const auto& p : s.points) {
+                json.beginObject().field("date", p.date).field("value", p.value);
+                if (!std::isnan(p.error)) json.field("error", p.error);
+                json.endObject();
+            }
+            json.endArray().endObject();
+        }
+        json.endArray();
+    }
+
+    if (!answer.advisories.empty()) {
+        json.key("advisories").beginArray();
+        for (const auto& a : answer.advisories) {
+            json.beginObject().field("district", a.district).field("state", a.state).field("date", a.date).field("api", a.api)
+                .field("status", a.status).field("level", a.level).field("advice", a.advice).endObject();
+        }
+        json.endArray();
+    }
+
+    if (!answer.text.empty()) json.field("text", answer.text);
+    json.endObject();
+}
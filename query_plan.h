@@ -0,0 +1,603 @@
+#pragma once
+// Logical query plans over the readings table and a batch-at-a-time executor.
+// Readings are mirrored into columns (dictionary-encoded area/state ids, API,
+// day number, month, status code); a plan is filter -> group-by -> aggregate
+// -> order/top-k, and handlers only render the result rows. The executor
+// works on fixed-size batches: each filter refines a selection vector, group
+// ids are computed for the survivors, and accumulators live in dense arrays
+// indexed by group id.
+//
+// Large scans are split into fixed-size morsels that a persistent
+// work-stealing pool processes in parallel; each worker keeps its own partial
+// aggregates (or a bounded top-k heap for row plans) and the partials are
+// merged at the end. Ties on a value or day always go to the lower row, so
+// the result is the same however the morsels were split or stolen
+// (QueryEngine::checkWorkers compares against a single worker). Queries
+// whose estimated row count is small stay on the calling thread.
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "memory_accounting.h"
+
+class ColumnTable {
+public:
+    enum Status : uint8_t { GOOD, MODERATE, UNHEALTHY, OTHER };
+
+    template <class T>
+    using Column = TrackedVector<T, MemSubsystem::RECORDS>;
+    using Name = TrackedString<MemSubsystem::STRINGS>;
+
+    void clear() {
+        area_.clear(); state_.clear(); api_.clear(); day_.clear(); month_.clear(); status_.clear();
+        min_day_ = min_month_ = INT_MAX;
+        max_day_ = max_month_ = INT_MIN;
+    }
+
+    void reserve(size_t rows) {
+        area_.reserve(rows); state_.reserve(rows); api_.reserve(rows);
+        day_.reserve(rows); month_.reserve(rows); status_.reserve(rows);
+    }
+
+    // `month` is year * 12 + (month - 1).
+    void append(const std::string& district, const std::string& state, int api, int day, int month,
+        const std::string& status) {
+        uint32_t state_id = intern(state_ids_, state_names_, state);
+        uint32_t area_id = intern(area_ids_, area_names_, district + ", " + state);
+        if (area_id == area_state_.size()) {
+            area_state_.push_back(state_id);
+            area_district_.push_back(Name(district.data(), district.size()));
+        }
+        area_.push_back(area_id);
+        state_.push_back(state_id);
+        api_.push_back(api);
+        day_.push_back(day);
+        month_.push_back(month);
+        min_day_ = std::min(min_day_, day);
+        max_day_ = std::max(max_day_, day);
+        min_month_ = std::min(min_month_, month);
+        max_month_ = std::max(max_month_, month);
+        status_.push_back(status == "Good" ? GOOD : status == "Moderate" ? MODERATE : status == "Unhealthy" ? UNHEALTHY : OTHER);
+    }
+
+    size_t size() const { return api_.size(); }
+    size_t areaCount() const { return area_names_.size(); }
+    size_t stateCount() const { return state_names_.size(); }
+    int minDay() const { return min_day_; }
+    int maxDay() const { return max_day_; }
+    int minMonth() const { return min_month_; }
+    int maxMonth() const { return max_month_; }
+
+    // "district, state" label, district and state of an area id.
+    const Name& areaName(uint32_t id) const { return area_names_[id]; }
+    const Name& areaDistrict(uint32_t id) const { return area_district_[id]; }
+    const Name& stateName(uint32_t id) const { return state_names_[id]; }
+    uint32_t areaState(uint32_t id) const { return area_state_[id]; }
+
+    long stateId(const std::string& state) const {
+        auto it = state_ids_.find(Name(state.data(), state.size()));
+        return it == state_ids_.end() ? -1 : static_cast<long>(it->second);
+    }
+
+    const Column<uint32_t>& area() const { return area_; }
+    const Column<uint32_t>& state() const { return state_; }
+    const Column<int32_t>& api() const { return api_; }
+    const Column<int32_t>& day() const { return day_; }
+    const Column<int32_t>& month() const { return month_; }
+    const Column<uint8_t>& status() const { return status_; }
+
+private:
+    using NameIds = std::unordered_map<Name, uint32_t, TrackedStringHash, std::equal_to<Name>,
+        TrackingAllocator<std::pair<const Name, uint32_t>, MemSubsystem::STRINGS>>;
+    using Names = TrackedVector<Name, MemSubsystem::STRINGS>;
+
+    static uint32_t intern(NameIds& ids, Names& names, const std::string& text) {
+        Name name(text.data(), text.size());
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(names.size());
+        ids.emplace(name, id);
+        names.push_back(name);
+        return id;
+    }
+
+    Column<uint32_t> area_, state_;
+    Column<int32_t> api_, day_, month_;
+    Column<uint8_t> status_;
+    int min_day_ = INT_MAX, max_day_ = INT_MIN;
+    int min_month_ = INT_MAX, max_month_ = INT_MIN;
+
+    NameIds area_ids_, state_ids_;
+    Names area_names_, state_names_, area_district_;
+    Column<uint32_t> area_state_;
+};
+
+struct QueryPlan {
+    enum class GroupBy { NONE, AREA, STATE, DAY, MONTH, ROW };
+    enum class Measure { AVG, MIN, MAX, COUNT, LATEST };
+    enum class Order { KEY, ASC, DESC };
+
+    // Filter (inclusive; defaults match everything).
+    int day_from = INT_MIN;
+    int day_to = INT_MAX;
+    long state = -1;                 // ColumnTable state id
+    std::vector<uint32_t> areas;     // empty = all areas
+
+    GroupBy group_by = GroupBy::NONE;
+    Measure measure = Measure::AVG;  // ROW groups always measure the reading itself
+    Order order = Order::KEY;
+    size_t limit = 0;                // 0 = all groups
+};
+
+struct ResultRow {
+    uint32_t group = 0;        // area / state id, day or month number, or row index
+    double value = 0;          // the plan's measure
+    size_t count = 0;
+    int64_t sum = 0;
+    int min = INT_MAX;
+    int max = INT_MIN;
+    size_t status_counts[4] = { 0, 0, 0, 0 };
+    size_t min_row = 0;        // first row holding min / max
+    size_t max_row = 0;
+    size_t latest_row = 0;     // last row on the latest day (a later reading corrects an earlier one)
+
+    double average() const { return count ? static_cast<double>(sum) / count : 0; }
+};
+
+// Runs fn(worker, begin, end) over [0, rows) in morsels on threads that are
+// started once and reused by every scan; the calling thread is worker 0.
+// Each worker starts with a contiguous share of the morsels and, once its own
+// queue is empty, steals from the back of the other queues. Scans from
+// several callers take turns.
+class MorselPool {
+public:
+    using Fn = std::function<void(size_t, size_t, size_t)>;
+
+    // One fewer thread than the hardware has, started on first use.
+    static MorselPool& shared() {
+        static MorselPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    explicit MorselPool(size_t threads) {
+        for (size_t t = 0; t < threads; t++) threads_.emplace_back(&MorselPool::loop, this, t + 1);
+    }
+
+    ~MorselPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    MorselPool(const MorselPool&) = delete;
+    MorselPool& operator=(const MorselPool&) = delete;
+
+    size_t workers() const { return threads_.size() + 1; }
+
+    void run(size_t rows, size_t morsel, size_t workers, const Fn& fn) {
+        std::lock_guard<std::mutex> turn(run_lock_);
+        size_t count = (rows + morsel - 1) / morsel;
+        workers = std::max<size_t>(1, std::min({ workers, count, this->workers() }));
+        queues_.reset(new Queue[workers]);
+        for (size_t m = 0; m < count; m++) queues_[m * workers / count].morsels.push_back(m);
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            fn_ = &fn;
+            rows_ = rows;
+            morsel_ = morsel;
+            active_ = workers;
+            busy_ = workers - 1;
+            generation_++;
+        }
+        if (workers > 1) wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> guard(lock_);
+        done_.wait(guard, [&] { return busy_ == 0; });
+        fn_ = nullptr;
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> morsels;
+    };
+
+    // A scan's generation cannot change until every worker it uses is done,
+    // so a worker never misses one it is part of.
+    void loop(size_t w) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> guard(lock_);
+        for (;;) {
+            wake_.wait(guard, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            if (w >= active_) continue;
+            guard.unlock();
+            work(w);
+            guard.lock();
+            if (--busy_ == 0) done_.notify_all();
+        }
+    }
+
+    bool take(size_t w, size_t& m) {
+        for (size_t k = 0; k < active_; k++) {
+            Queue& q = queues_[(w + k) % active_];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.morsels.empty()) continue;
+            if (k == 0) { m = q.morsels.front(); q.morsels.pop_front(); }
+            else { m = q.morsels.back(); q.morsels.pop_back(); }
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t w) {
+        size_t m;
+        while (take(w, m)) (*fn_)(w, m * morsel_, std::min(rows_, (m + 1) * morsel_));
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex run_lock_;
+    std::mutex lock_;
+    std::condition_variable wake_, done_;
+    std::unique_ptr<Queue[]> queues_;
+    const Fn* fn_ = nullptr;
+    size_t rows_ = 0, morsel_ = 1, active_ = 0, busy_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+class QueryEngine {
+public:
+    static constexpr size_t kBatch = 1024;
+    static constexpr size_t kMorsel = 16 * kBatch;
+    static constexpr size_t kRowsPerWorker = 128 * 1024;  // below this a scan stays single-threaded
+
+    // `max_workers` = 0 uses every hardware thread the estimate justifies.
+    static std::vector<ResultRow> execute(const ColumnTable& table, const QueryPlan& plan, size_t max_workers = 0) {
+        MorselPool& pool = MorselPool::shared();
+        size_t workers = std::max<size_t>(1, estimateRows(table, plan) / kRowsPerWorker);
+        workers = std::min(workers, max_workers ? max_workers : pool.workers());
+        return executeOn(pool, table, plan, workers);
+    }
+
+    // Up to `workers` workers of `pool`, whatever the estimate.
+    static std::vector<ResultRow> executeOn(MorselPool& pool, const ColumnTable& table, const QueryPlan& plan,
+        size_t workers) {
+        Layout layout = layoutFor(table, plan);
+        const size_t n = table.size();
+
+        std::vector<Partial> partials(std::max<size_t>(1, workers));
+        for (auto& p : partials) p.groups.resize(layout.groups);
+        if (partials.size() == 1) {
+            scan(table, plan, layout, 0, n, partials[0]);
+        }
+        else {
+            pool.run(n, kMorsel, partials.size(), [&](size_t w, size_t begin, size_t end) {
+                scan(table, plan, layout, begin, end, partials[w]);
+            });
+        }
+
+        Partial& result = partials[0];
+        for (size_t w = 1; w < partials.size(); w++) merge(table, plan, partials[w], result);
+        return finish(table, plan, layout, result);
+    }
+
+    // Runs every plan shape (group-by, order, limit, filters) over a
+    // generated table full of tied readings with one worker and with
+    // `workers` workers, and describes the first result that differs.
+    // Empty when every plan agrees.
+    static std::string checkWorkers(size_t workers) {
+        ColumnTable table;
+        static const char* statuses[] = { "Good", "Moderate", "Unhealthy" };
+        uint32_t seed = 12345;
+        for (int day = 0; day < 1000; day++) {
+            for (int a = 0; a < 300; a++) {
+                seed = seed * 1103515245u + 12345u;
+                int api = static_cast<int>((seed >> 16) % 200);
+                int d = 20000 + day - (a % 7 == 0 ? day % 3 : 0);   // some areas repeat days
+                table.append("A" + std::to_string(a), "S" + std::to_string(a % 13), api, d, d / 30,
+                    statuses[api * 3 / 200]);
+            }
+        }
+
+        MorselPool pool(std::max<size_t>(2, workers) - 1);
+        const QueryPlan::GroupBy groupings[] = { QueryPlan::GroupBy::NONE, QueryPlan::GroupBy::AREA,
+            QueryPlan::GroupBy::STATE, QueryPlan::GroupBy::DAY, QueryPlan::GroupBy::MONTH, QueryPlan::GroupBy::ROW };
+        const QueryPlan::Order orders[] = { QueryPlan::Order::KEY, QueryPlan::Order::ASC, QueryPlan::Order::DESC };
+        const QueryPlan::Measure measures[] = { QueryPlan::Measure::AVG, QueryPlan::Measure::MIN,
+            QueryPlan::Measure::MAX, QueryPlan::Measure::LATEST };
+        for (auto group_by : groupings) {
+            for (auto order : orders) {
+                for (auto measure : measures) {
+                    for (size_t limit : { 0, 5 }) {
+                        for (int filter = 0; filter < 3; filter++) {
+                            QueryPlan plan;
+                            plan.group_by = group_by;
+                            plan.order = order;
+                            plan.measure = measure;
+                            plan.limit = limit;
+                            if (filter == 1) { plan.day_from = 20100; plan.day_to = 20700; }
+                            if (filter == 2) { plan.state = 3; plan.areas = { 3, 16, 29, 42 }; }
+                            std::string diff = compare(executeOn(pool, table, plan, 1),
+                                executeOn(pool, table, plan, pool.workers()));
+                            if (diff.empty()) continue;
+                            std::stringstream ss;
+                            ss << "group_by " << static_cast<int>(group_by) << ", order " << static_cast<int>(order)
+                                << ", measure " << static_cast<int>(measure) << ", limit " << limit
+                                << ", filter " << filter << ": " << diff;
+                            return ss.str();
+                        }
+                    }
+                }
+            }
+        }
+        return "";
+    }
+
+    // Rows the plan's date filter is expected to keep, assuming readings are
+    // spread evenly over the table's date range.
+    static size_t estimateRows(const ColumnTable& table, const QueryPlan& plan) {
+        if (table.size() == 0) return 0;
+        double span = static_cast<double>(table.maxDay()) - table.minDay() + 1;
+        double from = std::max<double>(plan.day_from, table.minDay());
+        double to = std::min<double>(plan.day_to, table.maxDay());
+        if (to < from) return 0;
+        return static_cast<size_t>(table.size() * std::min(1.0, (to - from + 1) / span));
+    }
+
+private:
+    struct Layout {
+        size_t groups = 1;
+        int32_t key_base = 0;
+        std::vector<uint8_t> area_mask;
+    };
+
+    struct Partial {
+        TrackedVector<ResultRow, MemSubsystem::QUERY> groups;   // dense accumulators
+        TrackedVector<size_t, MemSubsystem::QUERY> rows;        // ROW plans: selected rows, a heap when limited
+    };
+
+    static Layout layoutFor(const ColumnTable& table, const QueryPlan& plan) {
+        Layout layout;
+        if (!plan.areas.empty()) {
+            layout.area_mask.assign(table.areaCount(), 0);
+            for (uint32_t a : plan.areas) if (a < layout.area_mask.size()) layout.area_mask[a] = 1;
+        }
+        switch (plan.group_by) {
+        case QueryPlan::GroupBy::AREA: layout.groups = table.areaCount(); break;
+        case QueryPlan::GroupBy::STATE: layout.groups = table.stateCount(); break;
+        case QueryPlan::GroupBy::DAY:
+        case QueryPlan::GroupBy::MONTH: {
+            bool by_day = plan.group_by == QueryPlan::GroupBy::DAY;
+            int lo = by_day ? table.minDay() : table.minMonth();
+            int hi = by_day ? table.maxDay() : table.maxMonth();
+            layout.key_base = lo;
+            layout.groups = table.size() ? static_cast<size_t>(hi - lo) + 1 : 0;
+            break;
+        }
+        case QueryPlan::GroupBy::ROW: layout.groups = 0; break;
+        default: break;
+        }
+        return layout;
+    }
+
+    // Top-k order for ROW plans; the earlier row wins ties.
+    static bool rowBefore(const ColumnTable& table, const QueryPlan& plan, size_t a, size_t b) {
+        int va = table.api()[a], vb = table.api()[b];
+        if (plan.order != QueryPlan::Order::KEY && va != vb) {
+            return plan.order == QueryPlan::Order::ASC ? va < vb : va > vb;
+        }
+        return a < b;
+    }
+
+    template <class Rows>
+    static void keepRow(const ColumnTable& table, const QueryPlan& plan, size_t row, Rows& rows) {
+        if (plan.limit == 0) {
+            rows.push_back(row);
+            return;
+        }
+        // Max-heap on rank: the front is the worst row currently kept.
+        auto cmp = [&](size_t a, size_t b) { return rowBefore(table, plan, a, b); };
+        if (rows.size() < plan.limit) {
+            rows.push_back(row);
+            std::push_heap(rows.begin(), rows.end(), cmp);
+        }
+        else if (rowBefore(table, plan, row, rows.front())) {
+            std::pop_heap(rows.begin(), rows.end(), cmp);
+            rows.back() = row;
+            std::push_heap(rows.begin(), rows.end(), cmp);
+        }
+    }
+
+    static void scan(const ColumnTable& table, const QueryPlan& plan, const Layout& layout,
+        size_t begin, size_t end, Partial& out) {
+        const int32_t* day = table.day().data();
+        const int32_t* api = table.api().data();
+        const uint32_t* area = table.area().data();
+        const uint32_t* state = table.state().data();
+        const uint8_t* status = table.status().data();
+        const int32_t* key_col = plan.group_by == QueryPlan::GroupBy::MONTH ? table.month().data() : day;
+        uint32_t sel[kBatch];
+        uint32_t gid[kBatch];
+
+        for (size_t base = begin; base < end; base += kBatch) {
+            const uint32_t len = static_cast<uint32_t>(std::min(kBatch, end - base));
+
+            // Filters, each a branch-free pass that compacts the selection vector.
+            uint32_t count = 0;
+            for (uint32_t i = 0; i < len; i++) {
+                int32_t d = day[base + i];
+                sel[count] = i;
+                count += (d >= plan.day_from) & (d <= plan.day_to);
+            }
+            if (plan.state >= 0) {
+                uint32_t kept = 0;
+                for (uint32_t j = 0; j < count; j++) {
+                    sel[kept] = sel[j];
+                    kept += state[base + sel[j]] == static_cast<uint32_t>(plan.state);
+                }
+                count = kept;
+            }
+            if (!layout.area_mask.empty()) {
+                uint32_t kept = 0;
+                for (uint32_t j = 0; j < count; j++) {
+                    sel[kept] = sel[j];
+                    kept += layout.area_mask[area[base + sel[j]]];
+                }
+                count = kept;
+            }
+
+            if (plan.group_by == QueryPlan::GroupBy::ROW) {
+                for (uint32_t j = 0; j < count; j++) keepRow(table, plan, base + sel[j], out.rows);
+                continue;
+            }
+
+            // Group ids.
+            switch (plan.group_by) {
+            case QueryPlan::GroupBy::AREA:
+                for (uint32_t j = 0; j < count; j++) gid[j] = area[base + sel[j]];
+                break;
+            case QueryPlan::GroupBy::STATE:
+                for (uint32_t j = 0; j < count; j++) gid[j] = state[base + sel[j]];
+                break;
+            case QueryPlan::GroupBy::DAY:
+            case QueryPlan::GroupBy::MONTH:
+                for (uint32_t j = 0; j < count; j++) gid[j] = static_cast<uint32_t>(key_col[base + sel[j]] - layout.key_base);
+                break;
+            default:
+                std::fill(gid, gid + count, 0u);
+                break;
+            }
+
+            // Aggregates.
+            for (uint32_t j = 0; j < count; j++) {
+                size_t row = base + sel[j];
+                ResultRow& r = out.groups[gid[j]];
+                int v = api[row];
+                // A worker can see a later morsel before an earlier one, so
+                // ties compare rows here as well as in merge().
+                if (r.count == 0 || v < r.min || (v == r.min && row < r.min_row)) { r.min = v; r.min_row = row; }
+                if (r.count == 0 || v > r.max || (v == r.max && row < r.max_row)) { r.max = v; r.max_row = row; }
+                int latest = day[r.latest_row];
+                if (r.count == 0 || day[row] > latest || (day[row] == latest && row > r.latest_row)) r.latest_row = row;
+                r.sum += v;
+                r.status_counts[status[row]]++;
+                r.count++;
+            }
+        }
+    }
+
+    static std::string compare(const std::vector<ResultRow>& one, const std::vector<ResultRow>& many) {
+        if (one.size() != many.size()) {
+            return std::to_string(one.size()) + " rows with one worker, " + std::to_string(many.size()) + " with several";
+        }
+        for (size_t i = 0; i < one.size(); i++) {
+            const ResultRow& a = one[i];
+            const ResultRow& b = many[i];
+            if (a.group != b.group || a.value != b.value || a.count != b.count || a.sum != b.sum || a.min != b.min ||
+                a.max != b.max || a.min_row != b.min_row || a.max_row != b.max_row || a.latest_row != b.latest_row ||
+                memcmp(a.status_counts, b.status_counts, sizeof(a.status_counts)) != 0) {
+                return "row " + std::to_string(i) + " (group " + std::to_string(a.group) + " vs " + std::to_string(b.group) + ") differs";
+            }
+        }
+        return "";
+    }
+
+    static void merge(const ColumnTable& table, const QueryPlan& plan, const Partial& from, Partial& into) {
+        if (plan.group_by == QueryPlan::GroupBy::ROW) {
+            for (size_t row : from.rows) keepRow(table, plan, row, into.rows);
+            return;
+        }
+        const int32_t* day = table.day().data();
+        for (size_t g = 0; g < from.groups.size(); g++) {
+            const ResultRow& s = from.groups[g];
+            ResultRow& r = into.groups[g];
+            if (s.count == 0) continue;
+            if (r.count == 0) { r = s; continue; }
+            if (s.min < r.min || (s.min == r.min && s.min_row < r.min_row)) { r.min = s.min; r.min_row = s.min_row; }
+            if (s.max > r.max || (s.max == r.max && s.max_row < r.max_row)) { r.max = s.max; r.max_row = s.max_row; }
+            if (day[s.latest_row] > day[r.latest_row] ||
+                (day[s.latest_row] == day[r.latest_row] && s.latest_row > r.latest_row)) r.latest_row = s.latest_row;
+            r.sum += s.sum;
+            r.count += s.count;
+            for (int k = 0; k < 4; k++) r.status_counts[k] += s.status_counts[k];
+        }
+    }
+
+    static std::vector<ResultRow> finish(const ColumnTable& table, const QueryPlan& plan, const Layout& layout,
+        Partial& partial) {
+        const int32_t* api = table.api().data();
+        const uint8_t* status = table.status().data();
+        std::vector<ResultRow> out;
+        if (plan.group_by == QueryPlan::GroupBy::ROW) {
+            out.reserve(partial.rows.size());
+            for (size_t row : partial.rows) {
+                ResultRow r;
+                r.group = static_cast<uint32_t>(row);
+                r.value = r.sum = r.min = r.max = api[row];
+                r.count = 1;
+                r.status_counts[status[row]] = 1;
+                r.min_row = r.max_row = r.latest_row = row;
+                out.push_back(r);
+            }
+        }
+        else {
+            for (size_t g = 0; g < partial.groups.size(); g++) {
+                ResultRow& r = partial.groups[g];
+                if (r.count == 0) continue;
+                r.group = static_cast<uint32_t>(g) + static_cast<uint32_t>(layout.key_base);
+                switch (plan.measure) {
+                case QueryPlan::Measure::AVG: r.value = r.average(); break;
+                case QueryPlan::Measure::MIN: r.value = r.min; break;
+                case QueryPlan::Measure::MAX: r.value = r.max; break;
+                case QueryPlan::Measure::COUNT: r.value = static_cast<double>(r.count); break;
+                case QueryPlan::Measure::LATEST: r.value = api[r.latest_row]; break;
+                }
+                out.push_back(r);
+            }
+        }
+
+        orderAndLimit(table, plan, out);
+        return out;
+    }
+
+    // Ties (and KEY order) fall back to the group label, so results are
+    // deterministic and match name-ordered listings.
+    static void orderAndLimit(const ColumnTable& table, const QueryPlan& plan, std::vector<ResultRow>& rows) {
+        auto key_less = [&](const ResultRow& a, const ResultRow& b) {
+            switch (plan.group_by) {
+            case QueryPlan::GroupBy::AREA: return table.areaName(a.group) < table.areaName(b.group);
+            case QueryPlan::GroupBy::STATE: return table.stateName(a.group) < table.stateName(b.group);
+            default: return a.group < b.group;
+            }
+        };
+        auto less = [&](const ResultRow& a, const ResultRow& b) {
+            if (plan.order != QueryPlan::Order::KEY && a.value != b.value) {
+                return plan.order == QueryPlan::Order::ASC ? a.value < b.value : a.value > b.value;
+            }
+            return key_less(a, b);
+        };
+
+        if (plan.limit > 0 && plan.limit < rows.size()) {
+            std::partial_sort(rows.begin(), rows.begin() + plan.limit, rows.end(), less);
+            rows.resize(plan.limit);
+        }
+        else {
+            std::sort(rows.begin(), rows.end(), less);
+        }
+    }
+};
@@ -0,0 +1,272 @@
+#pragma once
+// Outer join of daily metric series (pm10, pm25, uvi, ...) on the day key.
+// Replaces the n8n "align UVI to PM10" JavaScript node: every day present in
+// any series is kept, and missing values are filled with null.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "json_writer.h"
+
+struct SeriesPoint {
+    std::string day;   // YYYY-MM-DD, sorts lexically
+    double avg;
+};
+
+struct MetricSeries {
+    std::string name;
+    std::vector<SeriesPoint> points;
+};
+
+struct AlignedSeries {
+    std::vector<std::string> names;
+    std::vector<std::string> days;
+    std::vector<std::vector<double>> values;   // values[metric][day], NAN = missing
+
+    static bool isMissing(double v) { return std::isnan(v); }
+
+    // {"days":[...],"pm10":[...],...} with null for missing values.
+    std::string toJson() const {
+        JsonWriter json;
+        json.beginObject().key("days").beginArray();
+        for (const auto& day : days) json.value(day);
+        json.endArray();
+        for (size_t m = 0; m < names.size(); m++) {
+            json.key(names[m]).beginArray();
+            for (double v : values[m]) {
+                if (isMissing(v)) json.null();
+                else json.value(v);
+            }
+            json.endArray();
+        }
+        json.endObject();
+        return json.str();
+    }
+};
+
+// K-way merge over day-sorted inputs: O(total points * number of series).
+// Inputs that are not already sorted are sorted first. Every name in
+// `required` is in the output, all null when the payload lacks that metric.
+inline AlignedSeries alignSeries(std::vector<MetricSeries> series, const std::vector<std::string>& required = {}) {
+    for (const auto& name : required) {
+        bool present = std::any_of(series.begin(), series.end(), [&](const MetricSeries& s) { return s.name == name; });
+        if (!present) series.push_back({ name, {} });
+    }
+    AlignedSeries result;
+    for (auto& s : series) {
+        auto by_day = [](const SeriesPoint& a, const SeriesPoint& b) { return a.day < b.day; };
+        if (!std::is_sorted(s.points.begin(), s.points.end(), by_day)) {
+            std::stable_sort(s.points.begin(), s.points.end(), by_day);
+        }
+        result.names.push_back(s.name);
+        result.values.emplace_back();
+    }
+
+    std::vector<size_t> cursor(series.size(), 0);
+    while (true) {
+        const std::string* next_day = nullptr;
+        for (size_t m = 0; m < series.size(); m++) {
+            if (cursor[m] < series[m].points.size()) {
+                const std::string& d = series[m].points[cursor[m]].day;
+                if (!next_day || d < *next_day) next_day = &d;
+            }
+        }
+        if (!next_day) break;
+
+        std::string day = *next_day;
+        result.days.push_back(day);
+        for (size_t m = 0; m < series.size(); m++) {
+            auto& pts = series[m].points;
+            if (cursor[m] < pts.size() && pts[cursor[m]].day == day) {
+                result.values[m].push_back(pts[cursor[m]].avg);
+                // Duplicate days within one series keep the first value.
+                while (cursor[m] < pts.size() && pts[cursor[m]].day == day) cursor[m]++;
+            }
+            else {
+                result.values[m].push_back(NAN);
+            }
+        }
+    }
+    return result;
+}
+
+// Parses the n8n forecast payload: either {"forecast":{...}} or the inner
+// object, where each key maps to an array of {"day": "...", "avg": n}.
+// Returns false (with `error` set) on malformed input, including anything
+// but whitespace after the top-level object.
+class ForecastJsonParser {
+public:
+    bool parse(const std::string& text, std::vector<MetricSeries>& out, std::string& error) {
+        s_ = &text;
+        pos_ = 0;
+        out.clear();
+        skipWs();
+        if (!expect('{')) return fail(error);
+
+        // Peek the first key: descend into "forecast" when wrapped.
+        size_t save = pos_;
+        std::string key;
+        skipWs();
+        if (peek() == '"' && readString(key) && key == "forecast") {
+            skipWs();
+            if (!expect(':')) return fail(error);
+            skipWs();
+            if (!expect('{')) return fail(error);
+            if (!readSeriesObject(out)) return fail(error);
+            // Other members of the wrapper are ignored.
+            skipWs();
+            while (peek() == ',') {
+                pos_++;
+                skipWs();
+                if (!readString(key)) return fail(error);
+                skipWs();
+                if (!expect(':') || !skipValue()) return fail(error);
+                skipWs();
+            }
+            if (!expect('}')) return fail(error);
+        }
+        else {
+            pos_ = save;
+            if (!readSeriesObject(out)) return fail(error);
+        }
+        skipWs();
+        if (pos_ != s_->size()) return fail(error);
+        return true;
+    }
+
+private:
+    bool readSeriesObject(std::vector<MetricSeries>& out) {
+        skipWs();
+        if (peek() == '}') { pos_++; return true; }
+        while (true) {
+            skipWs();
+            MetricSeries series;
+            if (!readString(series.name)) return false;
+            skipWs();
+            if (!expect(':')) return false;
+            skipWs();
+            if (!expect('[')) return false;
+            skipWs();
+            if (peek() == ']') pos_++;
+            else {
+                while (true) {
+                    SeriesPoint pt;
+                    if (!readPoint(pt)) return false;
+                    series.points.push_back(pt);
+                    skipWs();
+                    if (peek() == ',') { pos_++; skipWs(); continue; }
+                    if (!expect(']')) return false;
+                    break;
+                }
+            }
+            out.push_back(std::move(series));
+            skipWs();
+            if (peek() == ',') { pos_++; continue; }
+            return expect('}');
+        }
+    }
+
+    bool readPoint(SeriesPoint& pt) {
+        skipWs();
+        if (!expect('{')) return false;
+        bool have_day = false;
+        pt.avg = NAN;
+        while (true) {
+            skipWs();
+            std::string key;
+            if (!readString(key)) return false;
+            skipWs();
+            if (!expect(':')) return false;
+            skipWs();
+            if (key == "day") {
+                if (!readString(pt.day)) return false;
+                have_day = true;
+            }
+            else if (key == "avg") {
+                if (!readNumberOrNull(pt.avg)) return false;
+            }
+            else if (!skipValue()) return false;
+            skipWs();
+            if (peek() == ',') { pos_++; continue; }
+            if (!expect('}')) return false;
+            return have_day;
+        }
+    }
+
+    bool readString(std::string& out) {
+        out.clear();
+        if (!expect('"')) return false;
+        while (pos_ < s_->size()) {
+            char c = (*s_)[pos_++];
+            if (c == '"') return true;
+            if (c == '\\') {
+                if (pos_ >= s_->size()) return false;
+                char e = (*s_)[pos_++];
+                switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': pos_ += 4; out += '?'; break;
+                default: out += e;
+                }
+            }
+            else out += c;
+        }
+        return false;
+    }
+
+    bool readNumberOrNull(double& v) {
+        if (s_->compare(pos_, 4, "null") == 0) { pos_ += 4; v = NAN; return true; }
+        size_t start = pos_;
+        while (pos_ < s_->size() && (isdigit(static_cast<unsigned char>((*s_)[pos_])) ||
+            strchr("+-.eE", (*s_)[pos_]))) pos_++;
+        if (start == pos_) return false;
+        try { v = std::stod(s_->substr(start, pos_ - start)); }
+        catch (...) { return false; }
+        return true;
+    }
+
+    bool skipValue() {
+        skipWs();
+        char c = peek();
+        if (c == '"') { std::string tmp; return readString(tmp); }
+        if (c == '{' || c == '[') {
+            int depth = 0;
+            bool in_str = false;
+            while (pos_ < s_->size()) {
+                char ch = (*s_)[pos_++];
+                if (in_str) {
+                    if (ch == '\\') pos_++;
+                    else if (ch == '"') in_str = false;
+                }
+                else if (ch == '"') in_str = true;
+                else if (ch == '{' || ch == '[') depth++;
+                else if ((ch == '}' || ch == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+        while (pos_ < s_->size() && !strchr(",}] \t\r\n", (*s_)[pos_])) pos_++;
+        return true;
+    }
+
+    void skipWs() {
+        while (pos_ < s_->size() && isspace(static_cast<unsigned char>((*s_)[pos_]))) pos_++;
+    }
+    char peek() const { return pos_ < s_->size() ? (*s_)[pos_] : '\0'; }
+    bool expect(char c) {
+        if (peek() != c) return false;
+        pos_++;
+        return true;
+    }
+    bool fail(std::string& error) {
+        error = "malformed forecast JSON near offset " + std::to_string(pos_);
+        return false;
+    }
+
+    const std::string* s_ = nullptr;
+    size_t pos_ = 0;
+};
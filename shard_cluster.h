@@ -0,0 +1,450 @@
+#pragma once
+// Scatter-gather over shard worker processes. Readings are sharded by state,
+// so every area and state lives on exactly one shard. The coordinator sends
+// each query plan to all shards at once, then merges the partial groups
+// (sums, counts, extremes with global row ids) and the per-shard top-k lists
+// with the same tie rules as QueryEngine, so answers match a single process.
+// Percentiles fetch the sketch tiles a QuantileStore query would merge and
+// merge them in the same order. Handlers that list readings (area history,
+// charts, date lookups, top-k days) fetch just those rows; the coordinator
+// keeps no copy of the data.
+//
+// The transport is supplied by the caller (one request line in, response
+// lines out); requests and rows are tab-separated text lines:
+//   PLAN <day_from> <day_to> <group_by> <measure> <order> <limit>
+//   TILES <is_state> <day_from> <day_to> <key>
+//   ROWS <day_from> <day_to> <district> <state>     (empty district = every area)
+//   AT <row>,<row>,...
+//   INFO
+//   INGEST <district> <state> <api> <status> <date> <row> [<district> ...]
+// Ingested readings are batched per shard (six fields each) and sent before
+// the next request reaches any shard, or once kIngestBatch are waiting; the
+// area, state and day summaries are updated locally.
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "query_plan.h"
+#include "quantile_sketch.h"
+
+class ShardCluster {
+public:
+    using Call = std::function<std::string(size_t shard, const std::string& request)>;
+
+    // Partial group as a shard reports it: the key names the group
+    // ("district|state", a state, or a day/month/row number) and row ids are
+    // global (positions in the full data file).
+    struct Partial {
+        std::string key;
+        ResultRow row;
+        int latest_day = INT_MIN;
+        int latest_api = 0;
+    };
+
+    // A reading as a shard returns it, with its global row id.
+    struct Reading {
+        size_t row = 0;
+        std::string district;
+        std::string state;
+        int api = 0;
+        std::string status;
+        std::string date;
+    };
+
+    // FNV-1a of the state name.
+    static size_t shardOf(const std::string& state, size_t shards) {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : state) { h ^= c; h *= 16777619u; }
+        return shards ? h % shards : 0;
+    }
+
+    static std::vector<std::string> split(const std::string& line, char sep) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (size_t at; (at = line.find(sep, start)) != std::string::npos; start = at + 1) {
+            fields.push_back(line.substr(start, at - start));
+        }
+        fields.push_back(line.substr(start));
+        return fields;
+    }
+
+    static std::string encodePlan(const QueryPlan& plan) {
+        std::stringstream ss;
+        ss << "PLAN\t" << plan.day_from << "\t" << plan.day_to << "\t" << static_cast<int>(plan.group_by) << "\t"
+            << static_cast<int>(plan.measure) << "\t" << static_cast<int>(plan.order) << "\t" << plan.limit;
+        return ss.str();
+    }
+
+    static bool decodePlan(const std::vector<std::string>& fields, QueryPlan& plan) {
+        if (fields.size() != 7) return false;
+        try {
+            plan.day_from = std::stoi(fields[1]);
+            plan.day_to = std::stoi(fields[2]);
+            plan.group_by = static_cast<QueryPlan::GroupBy>(std::stoi(fields[3]));
+            plan.measure = static_cast<QueryPlan::Measure>(std::stoi(fields[4]));
+            plan.order = static_cast<QueryPlan::Order>(std::stoi(fields[5]));
+            plan.limit = std::stoul(fields[6]);
+        }
+        catch (...) { return false; }
+        return true;
+    }
+
+    // Groups that span shards (whole table, days, months) must be merged
+    // before ordering, so shards return them all; area, state and row
+    // groups are shard-local and keep the plan's top-k.
+    static QueryPlan shardPlan(QueryPlan plan) {
+        if (plan.group_by != QueryPlan::GroupBy::AREA && plan.group_by != QueryPlan::GroupBy::STATE &&
+            plan.group_by != QueryPlan::GroupBy::ROW) {
+            plan.order = QueryPlan::Order::KEY;
+            plan.limit = 0;
+        }
+        return plan;
+    }
+
+    static std::string encodePartial(const Partial& p) {
+        const ResultRow& r = p.row;
+        std::stringstream ss;
+        ss << p.key << "\t" << r.count << "\t" << r.sum << "\t" << r.min << "\t" << r.max << "\t"
+            << r.min_row << "\t" << r.max_row << "\t" << r.latest_row << "\t" << p.latest_day << "\t" << p.latest_api;
+        for (size_t s : r.status_counts) ss << "\t" << s;
+        return ss.str();
+    }
+
+    static bool decodePartial(const std::string& line, Partial& p) {
+        std::vector<std::string> f = split(line, '\t');
+        if (f.size() != 14) return false;
+        try {
+            p.key = f[0];
+            p.row.count = std::stoul(f[1]);
+            p.row.sum = std::stoll(f[2]);
+            p.row.min = std::stoi(f[3]);
+            p.row.max = std::stoi(f[4]);
+            p.row.min_row = std::stoul(f[5]);
+            p.row.max_row = std::stoul(f[6]);
+            p.row.latest_row = std::stoul(f[7]);
+            p.latest_day = std::stoi(f[8]);
+            p.latest_api = std::stoi(f[9]);
+            for (int k = 0; k < 4; k++) p.row.status_counts[k] = std::stoul(f[10 + k]);
+        }
+        catch (...) { return false; }
+        return true;
+    }
+
+    static std::string encodeReading(const Reading& r) {
+        std::stringstream ss;
+        ss << r.row << "\t" << r.district << "\t" << r.state << "\t" << r.api << "\t" << r.status << "\t" << r.date;
+        return ss.str();
+    }
+
+    static bool decodeReading(const std::string& line, Reading& r) {
+        std::vector<std::string> f = split(line, '\t');
+        if (f.size() != 6) return false;
+        try {
+            r.row = std::stoul(f[0]);
+            r.api = std::stoi(f[3]);
+        }
+        catch (...) { return false; }
+        r.district = f[1];
+        r.state = f[2];
+        r.status = f[4];
+        r.date = f[5];
+        return true;
+    }
+
+    void connect(size_t shards, Call call) {
+        shards_ = shards;
+        call_ = std::move(call);
+        refreshInfo();
+    }
+
+    bool active() const { return shards_ > 0; }
+    size_t size() const { return shards_; }
+
+    std::vector<ResultRow> execute(const QueryPlan& plan) {
+        std::vector<std::string> replies = scatter(encodePlan(shardPlan(plan)));
+
+        // Merge partials by group key; extremes keep the earliest global row.
+        std::vector<Partial> groups;
+        std::unordered_map<std::string, size_t> index;
+        bool by_row = plan.group_by == QueryPlan::GroupBy::ROW;
+        for (const auto& reply : replies) {
+            for (const auto& line : lines(reply)) {
+                Partial p;
+                if (!decodePartial(line, p)) continue;
+                auto it = index.find(p.key);
+                if (by_row || it == index.end()) {
+                    index[p.key] = groups.size();
+                    groups.push_back(p);
+                    continue;
+                }
+                Partial& into = groups[it->second];
+                ResultRow& r = into.row;
+                const ResultRow& s = p.row;
+                if (s.min < r.min || (s.min == r.min && s.min_row < r.min_row)) { r.min = s.min; r.min_row = s.min_row; }
+                if (s.max > r.max || (s.max == r.max && s.max_row < r.max_row)) { r.max = s.max; r.max_row = s.max_row; }
+                if (p.latest_day > into.latest_day || (p.latest_day == into.latest_day && s.latest_row > r.latest_row)) {
+                    r.latest_row = s.latest_row;
+                    into.latest_day = p.latest_day;
+                    into.latest_api = p.latest_api;
+                }
+                r.sum += s.sum;
+                r.count += s.count;
+                for (int k = 0; k < 4; k++) r.status_counts[k] += s.status_counts[k];
+            }
+        }
+
+        std::vector<ResultRow> out;
+        std::vector<std::string> labels;   // ordering key for area / state groups
+        for (auto& p : groups) {
+            ResultRow& r = p.row;
+            std::string label;
+            switch (plan.group_by) {
+            case QueryPlan::GroupBy::AREA: {
+                size_t bar = p.key.find('|');
+                label = p.key.substr(0, bar) + ", " + p.key.substr(bar + 1);
+                r.group = intern(area_ids_, p.key);
+                break;
+            }
+            case QueryPlan::GroupBy::STATE:
+                label = p.key;
+                r.group = intern(state_ids_, p.key);
+                break;
+            default:
+                r.group = static_cast<uint32_t>(std::stoll(p.key));
+                break;
+            }
+            if (by_row) r.value = r.sum;
+            else {
+                switch (plan.measure) {
+                case QueryPlan::Measure::AVG: r.value = r.average(); break;
+                case QueryPlan::Measure::MIN: r.value = r.min; break;
+                case QueryPlan::Measure::MAX: r.value = r.max; break;
+                case QueryPlan::Measure::COUNT: r.value = static_cast<double>(r.count); break;
+                case QueryPlan::Measure::LATEST: r.value = p.latest_api; break;
+                }
+            }
+            out.push_back(r);
+            labels.push_back(label);
+        }
+        orderAndLimit(plan, out, labels);
+        return out;
+    }
+
+    // District and state of an area group id returned by execute().
+    std::pair<std::string, std::string> area(uint32_t id) const {
+        const std::string& key = names_[id];
+        size_t bar = key.find('|');
+        return { key.substr(0, bar), key.substr(bar + 1) };
+    }
+    const std::string& stateName(uint32_t id) const { return names_[id]; }
+
+    // Same merge sequence as QuantileStore::query on the combined data.
+    QuantileStore::Result quantiles(const std::string& key, bool is_state, int day_from, int day_to) {
+        std::stringstream ss;
+        ss << "TILES\t" << (is_state ? 1 : 0) << "\t" << day_from << "\t" << day_to << "\t" << key;
+        std::vector<std::string> replies;
+        if (is_state && key.empty()) replies = scatter(ss.str());
+        else {
+            std::string state = is_state ? key : key.substr(key.find('|') + 1);
+            replies.push_back(call(shardOf(state, shards_), ss.str()));
+        }
+
+        // Tiles arrive grouped by label; states merge in name order.
+        std::map<std::string, std::vector<std::string>> by_label;
+        for (const auto& reply : replies) {
+            for (const auto& line : lines(reply)) {
+                size_t tab = line.find('\t');
+                if (tab != std::string::npos) by_label[line.substr(0, tab)].push_back(line.substr(tab + 1));
+            }
+        }
+        QuantileStore::Result result;
+        for (const auto& label : by_label) {
+            for (const auto& text : label.second) {
+                KllSketch tile;
+                if (!KllSketch::decode(text, tile)) continue;
+                result.sketch.merge(tile);
+                result.sketches_merged++;
+            }
+        }
+        return result;
+    }
+
+    // Readings of one area (every area when `district` is empty) on days
+    // [day_from, day_to], in global row order. One area lives on one shard.
+    std::vector<Reading> readings(const std::string& district, const std::string& state, int day_from, int day_to) {
+        std::stringstream ss;
+        ss << "ROWS\t" << day_from << "\t" << day_to << "\t" << district << "\t" << state;
+        std::vector<std::string> replies;
+        if (district.empty()) replies = scatter(ss.str());
+        else replies.push_back(call(shardOf(state, shards_), ss.str()));
+        return decodeReadings(replies);
+    }
+
+    // The readings at global rows (as returned by execute()), in the order
+    // asked; rows no shard holds are left out.
+    std::vector<Reading> readingsAt(const std::vector<size_t>& rows) {
+        if (rows.empty()) return {};
+        std::string request = "AT\t";
+        for (size_t i = 0; i < rows.size(); i++) request += (i ? "," : "") + std::to_string(rows[i]);
+        std::vector<Reading> found = decodeReadings(scatter(request));
+        std::vector<Reading> out;
+        for (size_t row : rows) {
+            auto it = std::lower_bound(found.begin(), found.end(), row,
+                [](const Reading& r, size_t value) { return r.row < value; });
+            if (it != found.end() && it->row == row) out.push_back(*it);
+        }
+        return out;
+    }
+
+    const std::vector<std::string>& areaKeys() const { return area_keys_; }
+    const std::vector<std::string>& stateKeys() const { return state_keys_; }
+    size_t areaCount() const { return area_keys_.size(); }
+    bool empty() const { return area_keys_.empty(); }
+    int firstDay() const { return first_day_; }
+    int lastDay() const { return last_day_; }
+
+    void ingest(const std::string& district, const std::string& state, int api, const std::string& status,
+        const std::string& date, int day, size_t row) {
+        size_t shard = shardOf(state, shards_);
+        std::string& batch = ingests_[shard];
+        if (batch.empty()) batch = "INGEST";
+        batch += "\t" + district + "\t" + state + "\t" + std::to_string(api) + "\t" + status + "\t" + date + "\t" + std::to_string(row);
+        if (++ingest_counts_[shard] >= kIngestBatch) flush(shard);
+
+        insertSorted(area_keys_, district + "|" + state);
+        insertSorted(state_keys_, state);
+        first_day_ = std::min(first_day_, day);
+        last_day_ = std::max(last_day_, day);
+    }
+
+private:
+    static constexpr size_t kIngestBatch = 256;
+
+    // Every request to a shard goes through here, after its waiting ingests.
+    std::string call(size_t shard, const std::string& request) {
+        flush(shard);
+        return call_(shard, request);
+    }
+
+    void flush(size_t shard) {
+        auto it = ingests_.find(shard);
+        if (it == ingests_.end()) return;
+        std::string batch = std::move(it->second);
+        ingests_.erase(it);
+        ingest_counts_.erase(shard);
+        call_(shard, batch);
+    }
+
+    static void insertSorted(std::vector<std::string>& keys, const std::string& key) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), key);
+        if (it == keys.end() || *it != key) keys.insert(it, key);
+    }
+
+    std::vector<std::string> scatter(const std::string& request) {
+        std::vector<std::string> replies(shards_);
+        std::vector<std::string> batches(shards_);
+        for (size_t i = 0; i < shards_; i++) {
+            auto it = ingests_.find(i);
+            if (it != ingests_.end()) batches[i] = std::move(it->second);
+        }
+        ingests_.clear();
+        ingest_counts_.clear();
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < shards_; i++) {
+            threads.emplace_back([this, &replies, &batches, &request, i]() {
+                if (!batches[i].empty()) call_(i, batches[i]);
+                replies[i] = call_(i, request);
+            });
+        }
+        for (auto& t : threads) t.join();
+        return replies;
+    }
+
+    static std::vector<Reading> decodeReadings(const std::vector<std::string>& replies) {
+        std::vector<Reading> out;
+        for (const auto& reply : replies) {
+            for (const auto& line : lines(reply)) {
+                Reading r;
+                if (decodeReading(line, r)) out.push_back(r);
+            }
+        }
+        std::sort(out.begin(), out.end(), [](const Reading& a, const Reading& b) { return a.row < b.row; });
+        return out;
+    }
+
+    static std::vector<std::string> lines(const std::string& reply) {
+        std::vector<std::string> out;
+        std::stringstream ss(reply);
+        std::string line;
+        while (std::getline(ss, line)) if (!line.empty()) out.push_back(line);
+        return out;
+    }
+
+    uint32_t intern(std::unordered_map<std::string, uint32_t>& ids, const std::string& key) {
+        auto it = ids.find(key);
+        if (it != ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(names_.size());
+        ids.emplace(key, id);
+        names_.push_back(key);
+        return id;
+    }
+
+    // Matches QueryEngine: measure order, then the group label (names for
+    // areas and states, the number otherwise; row ids for row plans).
+    static void orderAndLimit(const QueryPlan& plan, std::vector<ResultRow>& rows, const std::vector<std::string>& labels) {
+        std::vector<size_t> order(rows.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        bool named = plan.group_by == QueryPlan::GroupBy::AREA || plan.group_by == QueryPlan::GroupBy::STATE;
+        auto less = [&](size_t a, size_t b) {
+            if (plan.order != QueryPlan::Order::KEY && rows[a].value != rows[b].value) {
+                return plan.order == QueryPlan::Order::ASC ? rows[a].value < rows[b].value : rows[a].value > rows[b].value;
+            }
+            return named ? labels[a] < labels[b] : rows[a].group < rows[b].group;
+        };
+        std::sort(order.begin(), order.end(), less);
+        if (plan.limit > 0 && plan.limit < order.size()) order.resize(plan.limit);
+
+        std::vector<ResultRow> sorted;
+        sorted.reserve(order.size());
+        for (size_t i : order) sorted.push_back(rows[i]);
+        rows.swap(sorted);
+    }
+
+    void refreshInfo() {
+        std::map<std::string, bool> areas, states;
+        first_day_ = INT32_MAX;
+        last_day_ = INT32_MIN;
+        for (const auto& reply : scatter("INFO")) {
+            for (const auto& line : lines(reply)) {
+                std::vector<std::string> f = split(line, '\t');
+                if (f.size() == 2 && f[0] == "area") areas[f[1]] = true;
+                else if (f.size() == 2 && f[0] == "state") states[f[1]] = true;
+                else if (f.size() == 3 && f[0] == "days") {
+                    first_day_ = std::min(first_day_, std::stoi(f[1]));
+                    last_day_ = std::max(last_day_, std::stoi(f[2]));
+                }
+            }
+        }
+        area_keys_.clear();
+        state_keys_.clear();
+        for (const auto& a : areas) area_keys_.push_back(a.first);
+        for (const auto& s : states) state_keys_.push_back(s.first);
+    }
+
+    size_t shards_ = 0;
+    Call call_;
+    std::unordered_map<std::string, uint32_t> area_ids_, state_ids_;
+    std::vector<std::string> names_;   // area keys and state names by group id
+    std::vector<std::string> area_keys_, state_keys_;
+    int first_day_ = INT32_MAX;
+    int last_day_ = INT32_MIN;
+    std::map<size_t, std::string> ingests_;   // shard -> waiting INGEST request
+    std::map<size_t, size_t> ingest_counts_;
+};
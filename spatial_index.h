@@ -0,0 +1,132 @@
+#pragma once
+// 2-D k-d tree over latitude/longitude for nearest-station lookups.
+// Points are projected onto a local equirectangular plane (km) for the tree
+// and reported with great-circle distances.
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+#include "memory_accounting.h"
+
+struct GeoPoint {
+    std::string name;
+    std::string state;
+    double lat;
+    double lon;
+};
+
+inline double haversineKm(double lat1, double lon1, double lat2, double lon2) {
+    const double kDegToRad = 3.14159265358979323846 / 180.0;
+    double dlat = (lat2 - lat1) * kDegToRad;
+    double dlon = (lon2 - lon1) * kDegToRad;
+    double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+        std::cos(lat1 * kDegToRad) * std::cos(lat2 * kDegToRad) * std::sin(dlon / 2) * std::sin(dlon / 2);
+    return 6371.0 * 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+}
+
+class KdTree {
+public:
+    struct Neighbor {
+        size_t index;       // into the points passed to build()
+        double distance_km;
+    };
+
+    void build(const std::vector<GeoPoint>& points) {
+        nodes_.clear();
+        xy_.clear();
+        if (points.empty()) return;
+
+        // Malaysia spans ~7 degrees of latitude, so one reference cosine
+        // keeps the projection error well under the distances we care about.
+        double mean_lat = 0;
+        for (const auto& p : points) mean_lat += p.lat;
+        mean_lat /= points.size();
+        cos_ref_ = std::cos(mean_lat * 3.14159265358979323846 / 180.0);
+
+        for (size_t i = 0; i < points.size(); i++) {
+            xy_.push_back({ project(points[i].lat, points[i].lon), i });
+        }
+        points_ = &points;
+        nodes_.reserve(points.size());
+        buildRange(0, xy_.size(), 0);
+    }
+
+    size_t size() const { return xy_.size(); }
+
+    // k nearest points, closest first. O(log n) on average.
+    std::vector<Neighbor> nearest(double lat, double lon, size_t k) const {
+        std::vector<Neighbor> result;
+        if (xy_.empty() || k == 0) return result;
+
+        Planar q = project(lat, lon);
+        std::priority_queue<std::pair<double, size_t>> heap;   // max-heap of (d^2, xy index)
+        search(0, q, k, heap);
+
+        while (!heap.empty()) {
+            size_t i = heap.top().second;
+            heap.pop();
+            const GeoPoint& p = (*points_)[xy_[i].second];
+            result.push_back({ xy_[i].second, haversineKm(lat, lon, p.lat, p.lon) });
+        }
+        std::sort(result.begin(), result.end(),
+            [](const Neighbor& a, const Neighbor& b) { return a.distance_km < b.distance_km; });
+        return result;
+    }
+
+private:
+    struct Planar {
+        double x, y;
+    };
+    struct Node {
+        size_t point;     // index into xy_
+        int axis;
+        int left = -1, right = -1;
+    };
+
+    Planar project(double lat, double lon) const {
+        return { lon * cos_ref_ * 111.32, lat * 110.57 };
+    }
+
+    int buildRange(size_t begin, size_t end, int depth) {
+        if (begin >= end) return -1;
+        int axis = depth % 2;
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(xy_.begin() + begin, xy_.begin() + mid, xy_.begin() + end,
+            [axis](const std::pair<Planar, size_t>& a, const std::pair<Planar, size_t>& b) {
+                return axis == 0 ? a.first.x < b.first.x : a.first.y < b.first.y;
+            });
+        int id = static_cast<int>(nodes_.size());
+        nodes_.push_back({ mid, axis });
+        int left = buildRange(begin, mid, depth + 1);
+        int right = buildRange(mid + 1, end, depth + 1);
+        nodes_[id].left = left;
+        nodes_[id].right = right;
+        return id;
+    }
+
+    void search(int node, const Planar& q, size_t k, std::priority_queue<std::pair<double, size_t>>& heap) const {
+        if (node < 0) return;
+        const Node& n = nodes_[node];
+        const Planar& p = xy_[n.point].first;
+        double dx = p.x - q.x, dy = p.y - q.y;
+        double d2 = dx * dx + dy * dy;
+        if (heap.size() < k) heap.push({ d2, n.point });
+        else if (d2 < heap.top().first) {
+            heap.pop();
+            heap.push({ d2, n.point });
+        }
+
+        double diff = n.axis == 0 ? q.x - p.x : q.y - p.y;
+        int near_side = diff < 0 ? n.left : n.right;
+        int far_side = diff < 0 ? n.right : n.left;
+        search(near_side, q, k, heap);
+        if (heap.size() < k || diff * diff < heap.top().first) search(far_side, q, k, heap);
+    }
+
+    TrackedVector<std::pair<Planar, size_t>, MemSubsystem::INDEXES> xy_;
+    TrackedVector<Node, MemSubsystem::INDEXES> nodes_;
+    const std::vector<GeoPoint>* points_ = nullptr;
+    double cos_ref_ = 1.0;
+};